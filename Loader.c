@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "Loader.h"
+
+#define CHUNK_SIZE (8 * 1024 * 1024) // bytes read from the file at once
+#define LOAD_FAILED (-1)
+
+/**
+ * a buffer of the input file. data[0 .. used) holds whole records, data[used .. length) is the start of a
+ * record that continues in the next chunk.
+ */
+typedef struct Chunk
+{
+	char *data;
+	size_t length;
+	size_t used;
+	size_t capacity;
+} Chunk;
+
+/**
+ * the records one worker thread parses and sorts.
+ */
+typedef struct ParseTask
+{
+	char **records;
+	int *lengths;
+	void **items; // the parsed items, sorted, in items[0 .. parsed)
+	void **scratch;
+	int count;
+	int parsed;
+	ParseFunc parse;
+	void *args;
+	CompareFunc compFunc;
+	pthread_t thread;
+} ParseTask;
+
+int fillChunk(FILE *file, Chunk *next, Chunk *prev, int recordSize, int *eof);
+int splitRecords(Chunk *chunk, int recordSize, char ***records, int **lengths, int *capacity);
+void *parseRecords(void *task);
+void mergeRuns(void **items, void **scratch, int lo, int mid, int hi, CompareFunc compFunc);
+void sortItems(void **items, void **scratch, int n, CompareFunc compFunc);
+long insertChunk(RBTree *tree, ParseTask *tasks, int numTasks, void **items, void **scratch);
+
+
+/**
+ * moves the partial record at the end of prev to the start of next and reads the file after it, until next
+ * holds at least one whole record or the file ends.
+ * @return 1 on success, 0 on failure
+ */
+int fillChunk(FILE *file, Chunk *next, Chunk *prev, int recordSize, int *eof)
+{
+    size_t carried = (prev == NULL) ? 0 : prev->length - prev->used;
+    if(next->capacity < carried + CHUNK_SIZE)
+    {
+        char * grown = (char *) realloc(next->data, carried + CHUNK_SIZE + 1);
+        if(grown == NULL)
+        {
+            return 0;
+        }
+        next->data = grown;
+        next->capacity = carried + CHUNK_SIZE;
+    }
+    if(carried > 0)
+    {
+        memcpy(next->data, prev->data + prev->used, carried);
+    }
+    next->length = carried;
+    next->used = 0;
+    while(!*eof && next->used == 0)
+    {
+        if(next->length == next->capacity) // a single record longer than the buffer
+        {
+            char * grown = (char *) realloc(next->data, 2 * next->capacity + 1);
+            if(grown == NULL)
+            {
+                return 0;
+            }
+            next->data = grown;
+            next->capacity *= 2;
+        }
+        size_t read = fread(next->data + next->length, 1, next->capacity - next->length, file);
+        next->length += read;
+        *eof = (read == 0);
+        if(recordSize > 0)
+        {
+            next->used = next->length - next->length % recordSize;
+        }
+        else
+        {
+            char * last = NULL;
+            for(char * p = next->data + next->length; p > next->data; --p)
+            {
+                if(p[-1] == '\n')
+                {
+                    last = p;
+                    break;
+                }
+            }
+            next->used = (last == NULL) ? 0 : (size_t) (last - next->data);
+        }
+    }
+    if(*eof && recordSize == 0)
+    {
+        next->used = next->length; // the last line may have no line break
+    }
+    return 1;
+}
+
+/**
+ * finds the records of a chunk. text lines are '\0' terminated in place.
+ * @return the number of records, -1 on failure
+ */
+int splitRecords(Chunk *chunk, int recordSize, char ***records, int **lengths, int *capacity)
+{
+    int count = 0;
+    char * p = chunk->data;
+    char * end = chunk->data + chunk->used;
+    while(p < end)
+    {
+        if(count == *capacity)
+        {
+            int grown = (*capacity == 0) ? 1024 : 2 * *capacity;
+            char ** moreRecords = (char **) realloc(*records, sizeof(char *) * grown);
+            if(moreRecords != NULL)
+            {
+                *records = moreRecords;
+            }
+            int * moreLengths = (int *) realloc(*lengths, sizeof(int) * grown);
+            if(moreLengths != NULL)
+            {
+                *lengths = moreLengths;
+            }
+            if(moreRecords == NULL || moreLengths == NULL)
+            {
+                return LOAD_FAILED;
+            }
+            *capacity = grown;
+        }
+        char * recordEnd = end;
+        if(recordSize > 0)
+        {
+            recordEnd = p + recordSize;
+        }
+        else
+        {
+            char * lineBreak = (char *) memchr(p, '\n', end - p);
+            recordEnd = (lineBreak == NULL) ? end : lineBreak;
+        }
+        (*records)[count] = p;
+        (*lengths)[count] = (int) (recordEnd - p);
+        if(recordSize == 0)
+        {
+            if(recordEnd > p && recordEnd[-1] == '\r')
+            {
+                --(*lengths)[count];
+            }
+            p[(*lengths)[count]] = '\0';
+            p = recordEnd + 1;
+        }
+        else
+        {
+            p = recordEnd;
+        }
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * merges the sorted runs items[lo .. mid) and items[mid .. hi).
+ */
+void mergeRuns(void **items, void **scratch, int lo, int mid, int hi, CompareFunc compFunc)
+{
+    int i = lo;
+    int j = mid;
+    int k = lo;
+    while(i < mid && j < hi)
+    {
+        scratch[k++] = (compFunc(items[j], items[i]) < 0) ? items[j++] : items[i++];
+    }
+    while(i < mid)
+    {
+        scratch[k++] = items[i++];
+    }
+    while(j < hi)
+    {
+        scratch[k++] = items[j++];
+    }
+    memcpy(items + lo, scratch + lo, sizeof(void *) * (hi - lo));
+}
+
+/**
+ * a bottom up merge sort, stable.
+ */
+void sortItems(void **items, void **scratch, int n, CompareFunc compFunc)
+{
+    for(int width = 1; width < n; width *= 2)
+    {
+        for(int lo = 0; lo + width < n; lo += 2 * width)
+        {
+            int hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+            mergeRuns(items, scratch, lo, lo + width, hi, compFunc);
+        }
+    }
+}
+
+/**
+ * the body of a worker thread: parses its records and sorts the items.
+ */
+void *parseRecords(void *task)
+{
+    ParseTask * t = (ParseTask *) task;
+    t->parsed = 0;
+    for(int i = 0; i < t->count; ++i)
+    {
+        void * item = t->parse(t->records[i], t->lengths[i], t->args);
+        if(item != NULL)
+        {
+            t->items[t->parsed++] = item;
+        }
+    }
+    sortItems(t->items, t->scratch, t->parsed, t->compFunc);
+    return NULL;
+}
+
+/**
+ * merges the sorted runs of the workers and adds them to the tree in one batch.
+ * @return the number of items added, -1 on failure
+ */
+long insertChunk(RBTree *tree, ParseTask *tasks, int numTasks, void **items, void **scratch)
+{
+    int n = 0;
+    int runEnds[numTasks];
+    for(int t = 0; t < numTasks; ++t) // the runs are in place, only the gaps of invalid records are closed
+    {
+        memmove(items + n, tasks[t].items, sizeof(void *) * tasks[t].parsed);
+        n += tasks[t].parsed;
+        runEnds[t] = n;
+    }
+    for(int width = 1; width < numTasks; width *= 2)
+    {
+        for(int t = 0; t + width < numTasks; t += 2 * width)
+        {
+            int lo = (t == 0) ? 0 : runEnds[t - 1];
+            int last = (t + 2 * width < numTasks) ? t + 2 * width - 1 : numTasks - 1;
+            mergeRuns(items, scratch, lo, runEnds[t + width - 1], runEnds[last], tree->compFunc);
+        }
+    }
+    size_t duplicates = 0;
+    int added = addBatchRBTree(tree, items, n, &duplicates);
+    // the items the tree did not take: the duplicates at the front, or all of them if the batch failed
+    size_t rejected = added ? duplicates : (size_t) n;
+    for(size_t i = 0; i < rejected; ++i)
+    {
+        tree->freeFunc(items[i]);
+    }
+    return added ? (long) (n - duplicates) : LOAD_FAILED;
+}
+
+/**
+ * add all the records of a file to a tree. the file is read in large chunks, and while one chunk is read the
+ * previous one is parsed and sorted by worker threads. the sorted chunk is then added with addBatchRBTree.
+ * records that are already in the tree are freed with the tree's FreeFunc.
+ * @param tree: the tree to add the items to.
+ * @param path: the input file.
+ * @param recordSize: the size of each record of a binary file, 0 for a text file with a record per line.
+ * @param parse: the function that makes an item of a record.
+ * @param args: more optional arguments to the parse function (may be null if the given function support it).
+ * @param numThreads: the number of parsing threads.
+ * @return: the number of items added to the tree, -1 on failure.
+ */
+long loadRBTree(RBTree *tree, const char *path, int recordSize, ParseFunc parse, void *args, int numThreads)
+{
+    if(tree == NULL || path == NULL || parse == NULL || recordSize < 0 || numThreads <= 0)
+    {
+        return LOAD_FAILED;
+    }
+    FILE * file = fopen(path, "rb");
+    if(file == NULL)
+    {
+        return LOAD_FAILED;
+    }
+    Chunk chunks[2] = {{NULL, 0, 0, 0}, {NULL, 0, 0, 0}};
+    ParseTask * tasks = (ParseTask *) malloc(sizeof(ParseTask) * numThreads);
+    char ** records = NULL;
+    int * lengths = NULL;
+    void ** items = NULL;
+    void ** scratch = NULL;
+    int capacity = 0;
+    int itemsCapacity = 0;
+    int eof = 0;
+    long added = 0;
+    int current = 0;
+    if(tasks == NULL || !fillChunk(file, &chunks[current], NULL, recordSize, &eof))
+    {
+        added = LOAD_FAILED;
+    }
+    while(added != LOAD_FAILED && chunks[current].used > 0)
+    {
+        int count = splitRecords(&chunks[current], recordSize, &records, &lengths, &capacity);
+        if(count != LOAD_FAILED && count > itemsCapacity)
+        {
+            free(items);
+            free(scratch);
+            items = (void **) malloc(sizeof(void *) * count);
+            scratch = (void **) malloc(sizeof(void *) * count);
+            itemsCapacity = (items == NULL || scratch == NULL) ? 0 : count;
+        }
+        if(count == LOAD_FAILED || itemsCapacity < count)
+        {
+            added = LOAD_FAILED;
+            break;
+        }
+        for(int t = 0; t < numThreads; ++t)
+        {
+            int from = (int) ((long) count * t / numThreads);
+            int to = (int) ((long) count * (t + 1) / numThreads);
+            tasks[t].records = records + from;
+            tasks[t].lengths = lengths + from;
+            tasks[t].items = items + from;
+            tasks[t].scratch = scratch + from;
+            tasks[t].count = to - from;
+            tasks[t].parse = parse;
+            tasks[t].args = args;
+            tasks[t].compFunc = tree->compFunc;
+        }
+        int started = 0;
+        while(started < numThreads && pthread_create(&tasks[started].thread, NULL, parseRecords, &tasks[started]) == 0)
+        {
+            ++started;
+        }
+        for(int t = started; t < numThreads; ++t) // no more threads, parse the rest right here
+        {
+            parseRecords(&tasks[t]);
+        }
+        int next = 1 - current; // read ahead while the workers parse
+        int filled = fillChunk(file, &chunks[next], &chunks[current], recordSize, &eof);
+        for(int t = 0; t < started; ++t)
+        {
+            pthread_join(tasks[t].thread, NULL);
+        }
+        long chunkAdded = insertChunk(tree, tasks, numThreads, items, scratch);
+        added = (chunkAdded == LOAD_FAILED || !filled) ? LOAD_FAILED : added + chunkAdded;
+        current = next;
+    }
+    fclose(file);
+    free(chunks[0].data);
+    free(chunks[1].data);
+    free(tasks);
+    free(records);
+    free(lengths);
+    free(items);
+    free(scratch);
+    return added;
+}
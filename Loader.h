@@ -0,0 +1,30 @@
+#ifndef RBTREE_LOADER_H
+#define RBTREE_LOADER_H
+
+#include "RBTree.h"
+
+/**
+ * a function that turns one record of an input file into a tree item. it is called from several threads at
+ * once, so it must not touch shared state without its own locking.
+ * @record: the record. a text line is '\0' terminated, without its line break.
+ * @length: the length of the record in bytes.
+ * @args: pointer to other arguments for the function.
+ * @return: a new item, NULL if the record is not valid (then it is skipped).
+ */
+typedef void *(*ParseFunc)(const char *record, int length, void *args);
+
+/**
+ * add all the records of a file to a tree. the file is read in large chunks, and while one chunk is read the
+ * previous one is parsed and sorted by worker threads. the sorted chunk is then added with addBatchRBTree.
+ * records that are already in the tree are freed with the tree's FreeFunc.
+ * @param tree: the tree to add the items to.
+ * @param path: the input file.
+ * @param recordSize: the size of each record of a binary file, 0 for a text file with a record per line.
+ * @param parse: the function that makes an item of a record.
+ * @param args: more optional arguments to the parse function (may be null if the given function support it).
+ * @param numThreads: the number of parsing threads.
+ * @return: the number of items added to the tree, -1 on failure.
+ */
+long loadRBTree(RBTree *tree, const char *path, int recordSize, ParseFunc parse, void *args, int numThreads);
+
+#endif //RBTREE_LOADER_H
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include "MultiIndex.h"
+
+void keepRecord(void *data);
+int freeRecord(const void *object, void *freeFunc);
+
+
+/**
+ * FreeFunc of the index trees: the records belong to the MultiIndex, not to the trees.
+ */
+void keepRecord(void *data)
+{
+    (void) data;
+}
+
+/**
+ * constructs a new MultiIndex.
+ * @param compFuncs: the comparators of the indexes, compFuncs[0] is the primary one.
+ * @param numIndexes: the number of indexes.
+ * @param freeFunc: a function to free a record.
+ * @return: a pointer to the new MultiIndex, NULL on failure.
+ */
+MultiIndex *newMultiIndex(CompareFunc *compFuncs, int numIndexes, FreeFunc freeFunc)
+{
+    if(compFuncs == NULL || numIndexes <= 0 || freeFunc == NULL)
+    {
+        return NULL;
+    }
+    MultiIndex * multiIndex = (MultiIndex *) malloc(sizeof(MultiIndex));
+    if(multiIndex == NULL)
+    {
+        return NULL;
+    }
+    multiIndex->indexes = (RBTree **) calloc(numIndexes, sizeof(RBTree *));
+    if(multiIndex->indexes == NULL)
+    {
+        free(multiIndex);
+        return NULL;
+    }
+    multiIndex->numIndexes = numIndexes;
+    multiIndex->freeFunc = freeFunc;
+    multiIndex->size = 0;
+    for(int i = 0; i < numIndexes; ++i)
+    {
+        multiIndex->indexes[i] = newRBTree(compFuncs[i], keepRecord);
+        if(multiIndex->indexes[i] == NULL)
+        {
+            freeMultiIndex(multiIndex);
+            return NULL;
+        }
+    }
+    return multiIndex;
+}
+
+/**
+ * add a record to all the indexes, or to none of them.
+ * @param multiIndex: the MultiIndex to add a record to.
+ * @param data: the record.
+ * @return: 0 on failure, other on success. (if an equal record is already in any index - failure).
+ */
+int addToMultiIndex(MultiIndex *multiIndex, void *data)
+{
+    if(multiIndex == NULL || data == NULL)
+    {
+        return 0;
+    }
+    for(int i = 0; i < multiIndex->numIndexes; ++i)
+    {
+        if(!addToRBTree(multiIndex->indexes[i], data))
+        {
+            while(--i >= 0) // roll back, removal does not allocate so it can't fail
+            {
+                removeFromRBTree(multiIndex->indexes[i], data);
+            }
+            return 0;
+        }
+    }
+    ++multiIndex->size;
+    return 1;
+}
+
+/**
+ * remove a record from all the indexes and free it.
+ * @param multiIndex: the MultiIndex to remove a record from.
+ * @param data: a record equal to the one to remove by the primary comparator.
+ * @return: 0 on failure, other on success. (if the record is not in the MultiIndex - failure).
+ */
+int removeFromMultiIndex(MultiIndex *multiIndex, void *data)
+{
+    void * stored = findMultiIndex(multiIndex, data);
+    if(stored == NULL)
+    {
+        return 0;
+    }
+    for(int i = 0; i < multiIndex->numIndexes; ++i)
+    {
+        removeFromRBTree(multiIndex->indexes[i], stored);
+    }
+    multiIndex->freeFunc(stored);
+    --multiIndex->size;
+    return 1;
+}
+
+/**
+ * find a record by the primary comparator.
+ * @param multiIndex: the MultiIndex to search in.
+ * @param data: a record equal to the one to find.
+ * @return: the stored record, NULL if it is not in the MultiIndex.
+ */
+void *findMultiIndex(MultiIndex *multiIndex, void *data)
+{
+    if(multiIndex == NULL)
+    {
+        return NULL;
+    }
+    return findRBTree(multiIndex->indexes[0], data);
+}
+
+/**
+ * Activate a function on the records in the range [from, to) of one index, in that index's order. if one of
+ * the activations of the function returns 0, the process stops.
+ * @param multiIndex: the MultiIndex with all the records.
+ * @param index: the index to walk.
+ * @param from: the lowest record of the range (inclusive), NULL for no lower bound.
+ * @param to: the end of the range (exclusive), NULL for no upper bound.
+ * @param func: the function to activate on the records.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachMultiIndex(MultiIndex *multiIndex, int index, void *from, void *to, forEachFunc func, void *args)
+{
+    if(multiIndex == NULL || index < 0 || index >= multiIndex->numIndexes)
+    {
+        return 0;
+    }
+    return forEachRangeRBTree(multiIndex->indexes[index], from, to, func, args);
+}
+
+/**
+ * forEachFunc that frees a record with the FreeFunc given in args.
+ */
+int freeRecord(const void *object, void *freeFunc)
+{
+    FreeFunc * func = (FreeFunc *) freeFunc;
+    (*func)((void *) object);
+    return 1;
+}
+
+/**
+ * free all memory of the MultiIndex, each record is freed once.
+ * @param multiIndex: the MultiIndex to free.
+ */
+void freeMultiIndex(MultiIndex *multiIndex)
+{
+    if(multiIndex == NULL)
+    {
+        return;
+    }
+    if(multiIndex->indexes[0] != NULL)
+    {
+        forEachRBTree(multiIndex->indexes[0], freeRecord, &multiIndex->freeFunc);
+    }
+    for(int i = 0; i < multiIndex->numIndexes; ++i)
+    {
+        freeRBTree(multiIndex->indexes[i]);
+    }
+    free(multiIndex->indexes);
+    free(multiIndex);
+}
@@ -0,0 +1,71 @@
+#ifndef RBTREE_MULTIINDEX_H
+#define RBTREE_MULTIINDEX_H
+
+#include "RBTree.h"
+
+/**
+ * a set of records with several orders over them. each order is an RBTree over the same record pointers, so
+ * every record is stored once and freed once. indexes[0] is the primary index, that identifies a record.
+ * the comparator of every other index must also be a total order, e.g. break ties by the primary key.
+ */
+typedef struct MultiIndex
+{
+	RBTree **indexes;
+	int numIndexes;
+	FreeFunc freeFunc;
+	size_t size;
+} MultiIndex;
+
+/**
+ * constructs a new MultiIndex.
+ * @param compFuncs: the comparators of the indexes, compFuncs[0] is the primary one.
+ * @param numIndexes: the number of indexes.
+ * @param freeFunc: a function to free a record.
+ * @return: a pointer to the new MultiIndex, NULL on failure.
+ */
+MultiIndex *newMultiIndex(CompareFunc *compFuncs, int numIndexes, FreeFunc freeFunc);
+
+/**
+ * add a record to all the indexes, or to none of them.
+ * @param multiIndex: the MultiIndex to add a record to.
+ * @param data: the record.
+ * @return: 0 on failure, other on success. (if an equal record is already in any index - failure).
+ */
+int addToMultiIndex(MultiIndex *multiIndex, void *data);
+
+/**
+ * remove a record from all the indexes and free it.
+ * @param multiIndex: the MultiIndex to remove a record from.
+ * @param data: a record equal to the one to remove by the primary comparator.
+ * @return: 0 on failure, other on success. (if the record is not in the MultiIndex - failure).
+ */
+int removeFromMultiIndex(MultiIndex *multiIndex, void *data);
+
+/**
+ * find a record by the primary comparator.
+ * @param multiIndex: the MultiIndex to search in.
+ * @param data: a record equal to the one to find.
+ * @return: the stored record, NULL if it is not in the MultiIndex.
+ */
+void *findMultiIndex(MultiIndex *multiIndex, void *data);
+
+/**
+ * Activate a function on the records in the range [from, to) of one index, in that index's order. if one of
+ * the activations of the function returns 0, the process stops.
+ * @param multiIndex: the MultiIndex with all the records.
+ * @param index: the index to walk.
+ * @param from: the lowest record of the range (inclusive), NULL for no lower bound.
+ * @param to: the end of the range (exclusive), NULL for no upper bound.
+ * @param func: the function to activate on the records.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachMultiIndex(MultiIndex *multiIndex, int index, void *from, void *to, forEachFunc func, void *args);
+
+/**
+ * free all memory of the MultiIndex, each record is freed once.
+ * @param multiIndex: the MultiIndex to free.
+ */
+void freeMultiIndex(MultiIndex *multiIndex);
+
+#endif //RBTREE_MULTIINDEX_H
@@ -6,6 +6,8 @@
 #define TA_EX3_PRODUCTEXAMPLE_C
 
 #include "RBTree.h"
+#include "Structs.h"
+#include "Loader.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -13,6 +15,11 @@
 #define LESS (-1)
 #define EQUAL (0)
 #define GREATER (1)
+#define CHECK_PRODUCTS (64)
+#define INVALID_SUBTREE (-1)
+#define LOADER_CHECK_FILE "loader_check.csv"
+#define LOADER_CHECK_THREADS (2)
+#define CHECK_DIM (3)
 
 typedef struct ProductExample
 {
@@ -45,6 +52,27 @@ int productComparatorByName(const void *a, const void *b)
 	}
 }
 
+/**
+ * Comparator for ProductExample by price, products of the same price are ordered by name
+ * @param a ProductExample*
+ * @param b ProductExample*
+ * @return -1 if a<b, 0 if a==b, 1 if b<a
+ */
+int productComparatorByPrice(const void *a, const void *b)
+{
+	ProductExample *first = (ProductExample *) a;
+	ProductExample *second = (ProductExample *) b;
+	if (first->price < second->price)
+	{
+		return LESS;
+	}
+	else if (first->price > second->price)
+	{
+		return GREATER;
+	}
+	return productComparatorByName(a, b);
+}
+
 void productFree(void *a)
 {
 	ProductExample *pProduct = (ProductExample *) a;
@@ -52,6 +80,44 @@ void productFree(void *a)
 	free(a);
 }
 
+/**
+ * ParseFunc (see Loader.h) for products written as a "name,price" line.
+ * @param record the line
+ * @param length the length of the line
+ * @param args not used
+ * @return a new product (free it with productFree), NULL if the line is not valid
+ */
+void *parseProduct(const char *record, int length, void *args)
+{
+	(void) args;
+	const char *comma = (const char *) memchr(record, ',', length);
+	if (comma == NULL || comma == record)
+	{
+		return NULL;
+	}
+	char *end;
+	double price = strtod(comma + 1, &end);
+	if (end == comma + 1)
+	{
+		return NULL;
+	}
+	ProductExample *product = (ProductExample *) malloc(sizeof(ProductExample));
+	if (product == NULL)
+	{
+		return NULL;
+	}
+	product->name = (char *) malloc(sizeof(char) * (comma - record + 1));
+	if (product->name == NULL)
+	{
+		free(product);
+		return NULL;
+	}
+	memcpy(product->name, record, comma - record);
+	product->name[comma - record] = '\0';
+	product->price = price;
+	return product;
+}
+
 /**
  *
  * @param pProduct pointer to product to print
@@ -133,6 +199,213 @@ void assertion(int passed, int assertion_num, char *msg)
 
 }
 
+/**
+ * checks the red black properties of a subtree: the order of the items, the parent pointers, the counts, no
+ * red node with a red child and the same number of black nodes on every path down.
+ * @param node the root of the subtree
+ * @param parent the expected parent of node
+ * @param low all the items of the subtree must be greater than low, NULL for no bound
+ * @param high all the items of the subtree must be lower than high, NULL for no bound
+ * @param compFunc the comparator of the tree
+ * @return the black height of the subtree, INVALID_SUBTREE if a property does not hold
+ */
+int checkSubTree(const Node *node, const Node *parent, const void *low, const void *high, CompareFunc compFunc)
+{
+	if (node == NULL)
+	{
+		return 0;
+	}
+	if (node->parent != parent || node->count < 1)
+	{
+		return INVALID_SUBTREE;
+	}
+	if ((low != NULL && compFunc(low, node->data) != LESS) || (high != NULL && compFunc(node->data, high) != LESS))
+	{
+		return INVALID_SUBTREE;
+	}
+	if (node->color == RED && ((node->left != NULL && node->left->color == RED) ||
+							   (node->right != NULL && node->right->color == RED)))
+	{
+		return INVALID_SUBTREE;
+	}
+	int left = checkSubTree(node->left, node, low, node->data, compFunc);
+	int right = checkSubTree(node->right, node, node->data, high, compFunc);
+	if (left == INVALID_SUBTREE || left != right)
+	{
+		return INVALID_SUBTREE;
+	}
+	return left + (node->color == BLACK);
+}
+
+size_t countNodes(const Node *node)
+{
+	return (node == NULL) ? 0 : 1 + countNodes(node->left) + countNodes(node->right);
+}
+
+/**
+ * @param tree a tree that keeps its items in nodes
+ * @return 1 if the tree keeps all the red black properties and its size, 0 otherwise
+ */
+int isValidTree(const RBTree *tree)
+{
+	if (tree->root == NULL)
+	{
+		return tree->size == 0;
+	}
+	return tree->root->color == BLACK && countNodes(tree->root) == tree->size &&
+		   checkSubTree(tree->root, NULL, NULL, NULL, tree->compFunc) != INVALID_SUBTREE;
+}
+
+/**
+ * @param i the index of the product
+ * @return a new product named "Product <i>", NULL if the allocation failed
+ */
+ProductExample *newCheckProduct(int i)
+{
+	char record[32];
+	int length = snprintf(record, sizeof(record), "Product %02d,%d", i, 100 + i);
+	return (ProductExample *) parseProduct(record, length, NULL);
+}
+
+/**
+ * @return the count of product i in the tree
+ */
+int countCheckProduct(RBTree *tree, int i)
+{
+	ProductExample *product = newCheckProduct(i);
+	int count = countRBTree(tree, product);
+	productFree(product);
+	return count;
+}
+
+/**
+ * checks that incrementing, removing, freezing and the union keep the counts and the red black properties.
+ * the tree uses nodes from the first item, so removeNode and its fixup run on every removal.
+ * @return 1 if all the checks passed, 0 otherwise
+ */
+int checkCountsAndRemoval()
+{
+	int passed = 1;
+	int i = 0;
+	RBTree *tree = newRBTree(productComparatorByName, productFree);
+	setFlatLimitRBTree(tree, 0);
+	for (i = 0; i < 2 * CHECK_PRODUCTS; i++)
+	{
+		incrementRBTree(tree, newCheckProduct(i % CHECK_PRODUCTS), i % 3 + 1);
+	}
+	for (i = 0; i < CHECK_PRODUCTS; i++)
+	{
+		int expected = i % 3 + 1 + (i + CHECK_PRODUCTS) % 3 + 1;
+		passed &= countCheckProduct(tree, i) == expected;
+	}
+	passed &= tree->size == CHECK_PRODUCTS && isValidTree(tree);
+	assertion(passed, 1, "incrementRBTree counts");
+
+	tree = thawRBTree(freezeRBTree(tree));
+	for (i = 0; i < CHECK_PRODUCTS; i++)
+	{
+		int expected = i % 3 + 1 + (i + CHECK_PRODUCTS) % 3 + 1;
+		passed &= countCheckProduct(tree, i) == expected;
+	}
+	assertion(passed, 2, "counts after freezeRBTree and thawRBTree");
+
+	RBTree *other = newRBTree(productComparatorByName, productFree);
+	for (i = 0; i < CHECK_PRODUCTS + CHECK_PRODUCTS / 2; i += 2)
+	{
+		incrementRBTree(other, newCheckProduct(i), 5);
+	}
+	unionRBTree(tree, other);
+	for (i = 0; i < CHECK_PRODUCTS + CHECK_PRODUCTS / 2; i++)
+	{
+		int expected = (i < CHECK_PRODUCTS) ? i % 3 + 1 + (i + CHECK_PRODUCTS) % 3 + 1 : 0;
+		expected += (i % 2 == 0) ? 5 : 0;
+		passed &= countCheckProduct(tree, i) == expected;
+	}
+	passed &= tree->size == CHECK_PRODUCTS + CHECK_PRODUCTS / 4 && isValidTree(tree);
+	assertion(passed, 3, "unionRBTree sums the counts");
+
+	for (i = 0; i < CHECK_PRODUCTS; i++)
+	{
+		// a step coprime to the size visits every product once, in a scattered order
+		int product = (i * 37) % CHECK_PRODUCTS;
+		if (product % 4 == 0)
+		{
+			incrementRBTree(tree, newCheckProduct(product), -countCheckProduct(tree, product));
+		}
+		else
+		{
+			ProductExample *key = newCheckProduct(product);
+			passed &= removeFromRBTree(tree, key) != 0;
+			productFree(key);
+		}
+		passed &= countCheckProduct(tree, product) == 0 && isValidTree(tree);
+	}
+	passed &= tree->size == CHECK_PRODUCTS / 4;
+	assertion(passed, 4, "removeFromRBTree and incrementRBTree down to 0");
+	freeRBTree(tree);
+	return passed;
+}
+
+/**
+ * writes CHECK_PRODUCTS lines to LOADER_CHECK_FILE with no line break after the last one, as the files of
+ * some editors end.
+ * @param vectors 1 for lines of coordinates "i,i.5,-i", 0 for products "Product <i>,<100 + i>"
+ * @return 1 on success, 0 otherwise
+ */
+int writeCheckFile(int vectors)
+{
+	FILE *file = fopen(LOADER_CHECK_FILE, "w");
+	if (file == NULL)
+	{
+		return 0;
+	}
+	int i = 0;
+	for (i = 0; i < CHECK_PRODUCTS; i++)
+	{
+		const char *separator = (i > 0) ? "\n" : "";
+		if (vectors)
+		{
+			fprintf(file, "%s%d,%d.5,%d", separator, i, i, -i);
+		}
+		else
+		{
+			fprintf(file, "%sProduct %02d,%d", separator, i, 100 + i);
+		}
+	}
+	return fclose(file) == 0;
+}
+
+/**
+ * checks that loadRBTree adds every line of a file of products and of a file of Vectors, the last line too.
+ * @return 1 if all the checks passed, 0 otherwise
+ */
+int checkLoader()
+{
+	int passed = writeCheckFile(0);
+	RBTree *tree = newRBTree(productComparatorByName, productFree);
+	setFlatLimitRBTree(tree, 0);
+	long added = passed ? loadRBTree(tree, LOADER_CHECK_FILE, 0, parseProduct, NULL, LOADER_CHECK_THREADS) : -1;
+	ProductExample *last = newCheckProduct(CHECK_PRODUCTS - 1);
+	passed &= added == CHECK_PRODUCTS && (size_t) added == tree->size && containsRBTree(tree, last) &&
+			  isValidTree(tree);
+	productFree(last);
+	freeRBTree(tree);
+	assertion(passed, 5, "loadRBTree of products");
+
+	passed &= writeCheckFile(1);
+	tree = newRBTree(vectorCompare1By1, freeVector);
+	setFlatLimitRBTree(tree, 0);
+	added = passed ? loadRBTree(tree, LOADER_CHECK_FILE, 0, parseVector, NULL, LOADER_CHECK_THREADS) : -1;
+	double coordinates[CHECK_DIM] = {CHECK_PRODUCTS - 1, CHECK_PRODUCTS - 0.5, -(CHECK_PRODUCTS - 1)};
+	Vector lastVector = {CHECK_DIM, coordinates};
+	passed &= added == CHECK_PRODUCTS && (size_t) added == tree->size && containsRBTree(tree, &lastVector) &&
+			  isValidTree(tree);
+	freeRBTree(tree);
+	assertion(passed, 6, "loadRBTree of Vectors");
+	remove(LOADER_CHECK_FILE);
+	return passed;
+}
+
 int main()
 {
 	ProductExample **products = getProducts();
@@ -166,9 +439,16 @@ int main()
 		}
 	}
 
-	printf("\nThe number of products in the tree is %d.\n\n", tree->size);
+	printf("\nThe number of products in the tree is %zu.\n\n", tree->size);
 	forEachRBTree(tree, printProduct, NULL);
 	freeResources(tree, &products);
+	int passed = checkCountsAndRemoval();
+	passed &= checkLoader();
+	if (!passed)
+	{
+		printf("Test failed, aborting");
+		return 3;
+	}
 	printf("test passed\n");
 	return 0;
 }
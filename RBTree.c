@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "RBTree.h"
 #include <stdlib.h>
+#include <string.h>
 
 
 #define NO_ROOT NULL
@@ -8,15 +9,72 @@
 #define EQUALS 0
 #define INSERT_FAILED 0
 #define INSERT_SUCCESS 1
+#define FIRST_SLOT 1 // the root of a frozen tree is at index 1
+#define SLOTS_PER_LINE 8 // pointers per 64 bytes cache line
+#define BATCH_GROUP 8 // lookups that advance together in a batch
+#define MAX_DEPTH 128 // a red black tree is at most 2 * log2(n + 1) deep
+#define NOT_FOUND 0
+#define FOUND 1
+#define INCREMENT_FAILED (-1)
+#define MERGE_RATIO 4 // a sorted batch is merged with its key range when that holds at most MERGE_RATIO nodes per item
+#define FLAT_LIMIT 64 // the default size up to which the items are kept in a sorted array
+#define FLAT_INITIAL_CAPACITY 4
+#define MAX_CACHE_CAPACITY (1 << 30)
+#define IS_FLAT(tree) ((tree)->root == NO_ROOT) // an empty tree counts as flat as well
+#define IS_MAP(tree) ((tree)->valueFreeFunc != NULL)
+#define VALUE_OF(node) (((MapNode *) (node))->value) // only for the nodes of a map tree
+
+#ifdef __GNUC__
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)
+#endif
 
 
 
 Node * findSuccessor(Node * start);
 Node * minNodeInSubTree(Node * head);
-Node * createNode(void * data);
-Node * potentialParent(RBTree *tree, Node * node);
+Node * createNode(RBTree *tree, void * data);
+void freeNode(RBTree *tree, Node * node);
+void clearCache(RBTree *tree);
+void freeCache(RBTree *tree);
+Node * cloneNodes(RBTree *clone, Node * node, Node * parent, CopyFunc copyFunc, int * failed);
+Node * findNode(RBTree *tree, void *data);
+void removeNode(RBTree *tree, Node * z);
+void fixRemoval(RBTree *tree, Node * x, Node * parent);
+void rotateLeft(RBTree *tree, Node * node);
+void rotateRight(RBTree *tree, Node * node);
+void transplant(RBTree *tree, Node * u, Node * v);
+int insertBelow(RBTree *tree, Node * start, void *data, Node * fresh, Node ** found);
+int insertWithFinger(RBTree *tree, void **items, size_t n, char * rejected);
+int mergeSorted(RBTree *tree, void **items, size_t n, size_t covered, char * rejected);
+size_t countRange(RBTree *tree, void * first, void * last, size_t limit);
 
 void freeNodesInDepth(RBTree * t, Node * node);
+int buildFromSorted(RBTree *tree, void ** items, size_t n, Node ** root);
+int redDepthFor(size_t n);
+Node * linkBalanced(Node ** nodes, size_t lo, size_t hi, Node * parent, int depth, int redDepth);
+int blackHeight(Node * root);
+int childHeight(Node * parent, int height, Node * child);
+Node * detachSubTree(Node * root);
+Node * joinWithPivot(Node * left, int leftHeight, Node * pivot, Node * right, int rightHeight, int * height);
+Node * joinTwo(Node * left, int leftHeight, Node * right, int rightHeight, int * height);
+Node * splitLast(Node * root, int height, Node ** last, int * restHeight);
+Node * splitAt(Node * root, int height, void * data, CompareFunc compFunc, Node ** less, int * lessHeight,
+               Node ** greater, int * greaterHeight);
+size_t sizeOfLess(Node * less, Node * greater, size_t total);
+Node * unionNodes(Node * a, int aHeight, Node * b, int bHeight, RBTree * treeB, size_t * removed, int * height);
+Node * intersectNodes(Node * a, int aHeight, Node * b, int bHeight, RBTree * treeA, RBTree * treeB, size_t * kept,
+                      int * height);
+Node * differenceNodes(Node * a, int aHeight, Node * b, int bHeight, RBTree * treeA, RBTree * treeB,
+                       size_t * removed, int * height);
+void fillEytzinger(void ** sorted, void ** items, size_t n, size_t k, size_t * next);
+void collectEytzinger(void ** items, void ** sorted, size_t n, size_t k, size_t * next);
+int flatSearch(RBTree *tree, void *data, size_t * index);
+int flatReserve(RBTree *tree, size_t capacity);
+int flatInsert(RBTree *tree, void *data);
+void flatRemove(RBTree *tree, size_t index);
+int promoteRBTree(RBTree *tree);
 void leftLeftCase(Node *, RBTree *);
 void leftRightCase(Node * , RBTree *);
 void rightLeftCase(Node *, RBTree *);
@@ -43,11 +101,264 @@ RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
     // initializing default fields in tree;
     newTree->compFunc = compFunc;
     newTree->freeFunc = freeFunc;
+    newTree->valueFreeFunc = NULL;
+    newTree->cache = NULL;
     newTree->root = NO_ROOT;
     newTree->size = EMPTY_TREE;
+    newTree->flat = NULL;
+    newTree->flatCapacity = 0;
+    newTree->flatLimit = FLAT_LIMIT;
     return newTree;
 }
 
+/**
+ * constructs a new map tree, that holds a value for each key. the keys are ordered and freed like the items
+ * of a plain tree, the values are freed with their own function.
+ * @param compFunc: a function to compare two keys.
+ * @param keyFreeFunc: a function to free a key.
+ * @param valueFreeFunc: a function to free a value, it is not called for NULL values.
+ * @return: a pointer to the new tree, NULL on failure.
+ */
+RBTree *newMapRBTree(CompareFunc compFunc, FreeFunc keyFreeFunc, FreeFunc valueFreeFunc)
+{
+    if(valueFreeFunc == NULL)
+    {
+        return NULL;
+    }
+    RBTree * tree = newRBTree(compFunc, keyFreeFunc);
+    if(tree == NULL)
+    {
+        return NULL;
+    }
+    tree->valueFreeFunc = valueFreeFunc;
+    tree->flatLimit = 0; // the values are kept in the nodes
+    return tree;
+}
+
+/**
+ * set the size up to which the tree keeps its items in a sorted array instead of nodes. a tree that already
+ * holds more items than the new limit moves to nodes right away.
+ * @param tree: the tree to configure.
+ * @param limit: the new limit, 0 to always use nodes.
+ * @return: 0 on failure, other on success.
+ */
+int setFlatLimitRBTree(RBTree *tree, size_t limit)
+{
+    if(tree == NULL || (IS_MAP(tree) && limit > 0))
+    {
+        return 0;
+    }
+    tree->flatLimit = limit;
+    if(IS_FLAT(tree) && tree->size > limit)
+    {
+        return promoteRBTree(tree);
+    }
+    return 1;
+}
+
+/**
+ * put a small cache of recently found items in front of the single item lookups (containsRBTree, findRBTree,
+ * countRBTree, removeFromRBTree, getRBTree), so a hot item is found with one comparison instead of a full
+ * descent. only a tree that uses nodes caches, and the batch lookups skip the cache. calling it again replaces
+ * the cache and resets its statistics. a lookup on a cached tree writes to the cache and its statistics, so
+ * lookups that would only read a plain tree are not safe to run concurrently on a cached one.
+ * @param tree: the tree to configure.
+ * @param hashFunc: a function to hash the items, may be NULL when capacity is 0.
+ * @param capacity: the number of cached items, rounded up to a power of 2. 0 removes the cache.
+ * @return: 0 on failure (then the old cache is kept), other on success.
+ */
+int setCacheRBTree(RBTree *tree, HashFunc hashFunc, size_t capacity)
+{
+    if(tree == NULL || capacity > MAX_CACHE_CAPACITY || (capacity > 0 && hashFunc == NULL))
+    {
+        return 0;
+    }
+    if(capacity == 0)
+    {
+        freeCache(tree);
+        return 1;
+    }
+    unsigned long slots = 1;
+    while(slots < capacity)
+    {
+        slots *= 2;
+    }
+    LookupCache * cache = (LookupCache *) malloc(sizeof(LookupCache));
+    if(cache == NULL)
+    {
+        return 0;
+    }
+    cache->slots = (Node **) calloc(slots, sizeof(Node *));
+    if(cache->slots == NULL)
+    {
+        free(cache);
+        return 0;
+    }
+    cache->hashFunc = hashFunc;
+    cache->mask = slots - 1;
+    cache->hits = 0;
+    cache->misses = 0;
+    freeCache(tree);
+    tree->cache = cache;
+    return 1;
+}
+
+/**
+ * @param tree: the tree with the cache.
+ * @param hits: out parameter for the number of lookups that were answered by the cache, may be NULL.
+ * @param misses: out parameter for the number of lookups that descended the tree, may be NULL.
+ * @return: 0 if the tree has no cache, other on success.
+ */
+int cacheStatsRBTree(RBTree *tree, long *hits, long *misses)
+{
+    if(tree == NULL || tree->cache == NULL)
+    {
+        return 0;
+    }
+    if(hits != NULL)
+    {
+        *hits = tree->cache->hits;
+    }
+    if(misses != NULL)
+    {
+        *misses = tree->cache->misses;
+    }
+    return 1;
+}
+
+/**
+ * empties the lookup cache of a tree, if it has one. needed before nodes are freed in bulk.
+ */
+void clearCache(RBTree *tree)
+{
+    if(tree->cache != NULL)
+    {
+        memset(tree->cache->slots, 0, sizeof(Node *) * (tree->cache->mask + 1));
+    }
+}
+
+/**
+ * frees the lookup cache of a tree, if it has one.
+ */
+void freeCache(RBTree *tree)
+{
+    if(tree->cache != NULL)
+    {
+        free(tree->cache->slots);
+        free(tree->cache);
+        tree->cache = NULL;
+    }
+}
+
+/**
+ * binary search over the items of a flat tree.
+ * @param tree a flat tree
+ * @param data the item to look for
+ * @param index out parameter for the index of the item, or of the first greater item if it is not found
+ * @return FOUND or NOT_FOUND
+ */
+int flatSearch(RBTree *tree, void *data, size_t * index)
+{
+    size_t lo = 0;
+    size_t hi = tree->size;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int compare = tree->compFunc(tree->flat[mid], data);
+        if(compare == EQUALS)
+        {
+            *index = mid;
+            return FOUND;
+        }
+        if(compare < EQUALS)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    *index = lo;
+    return NOT_FOUND;
+}
+
+/**
+ * grows the array of a flat tree to hold at least capacity items.
+ * @return 1 on success, 0 if the memory allocation failed (then the tree is left untouched)
+ */
+int flatReserve(RBTree *tree, size_t capacity)
+{
+    if(capacity <= tree->flatCapacity)
+    {
+        return 1;
+    }
+    void ** grown = (void **) realloc(tree->flat, sizeof(void *) * capacity);
+    if(grown == NULL)
+    {
+        return 0;
+    }
+    tree->flat = grown;
+    tree->flatCapacity = capacity;
+    return 1;
+}
+
+/**
+ * adds an item to a flat tree that has room for it below its flat limit.
+ * @return INSERT_SUCCESS, or INSERT_FAILED if the item already exists or on failure
+ */
+int flatInsert(RBTree *tree, void *data)
+{
+    size_t index;
+    if(flatSearch(tree, data, &index))
+    {
+        return INSERT_FAILED;
+    }
+    if(tree->size == tree->flatCapacity)
+    {
+        size_t capacity = (tree->flatCapacity == 0) ? FLAT_INITIAL_CAPACITY : 2 * tree->flatCapacity;
+        if(!flatReserve(tree, (capacity > tree->flatLimit) ? tree->flatLimit : capacity))
+        {
+            return INSERT_FAILED;
+        }
+    }
+    memmove(tree->flat + index + 1, tree->flat + index, sizeof(void *) * (tree->size - index));
+    tree->flat[index] = data;
+    ++tree->size;
+    return INSERT_SUCCESS;
+}
+
+/**
+ * removes the item at the given index of a flat tree, and frees it.
+ */
+void flatRemove(RBTree *tree, size_t index)
+{
+    tree->freeFunc(tree->flat[index]);
+    memmove(tree->flat + index, tree->flat + index + 1, sizeof(void *) * (tree->size - index - 1));
+    --tree->size;
+}
+
+/**
+ * moves the items of a flat tree into nodes. does nothing for a tree that already uses nodes.
+ * @param tree the tree
+ * @return 1 on success, 0 if a memory allocation failed (then the tree stays flat)
+ */
+int promoteRBTree(RBTree *tree)
+{
+    if(!IS_FLAT(tree))
+    {
+        return 1;
+    }
+    if(!buildFromSorted(tree, tree->flat, tree->size, &tree->root))
+    {
+        return 0;
+    }
+    free(tree->flat);
+    tree->flat = NULL;
+    tree->flatCapacity = 0;
+    return 1;
+}
+
 
 /**
  * Finds a given node t's uncle
@@ -270,216 +581,2204 @@ int addToRBTree(RBTree *tree, void *data)
     {
         return INSERT_FAILED;
     }
-    if (containsRBTree(tree, data)) // Tree already contains data;
+    if(IS_FLAT(tree) && tree->size < tree->flatLimit)
+    {
+        return flatInsert(tree, data);
+    }
+    if(!promoteRBTree(tree))
     {
         return INSERT_FAILED;
     }
-    Node * z = createNode(data); // Creating the node to be inserted
+    Node * found;
+    return insertBelow(tree, tree->root, data, NULL, &found);
+}
+
+
+/**
+ * finds the place of data in the subtree of start and links a new node there, in a single descent.
+ * @param tree the tree to add an item to
+ * @param start the root of the subtree that should hold data (the tree's root for a plain insert)
+ * @param data the item to add
+ * @param fresh a node allocated in advance for data, or NULL to allocate one only if data is not found.
+ *        a fresh node that is not linked still belongs to the caller
+ * @param found out parameter for the node holding data: the new node, an equal existing node or NULL if
+ *        the memory allocation failed
+ * @return INSERT_SUCCESS if a node was added, INSERT_FAILED if the item already exists or on failure
+ */
+int insertBelow(RBTree *tree, Node * start, void *data, Node * fresh, Node ** found)
+{
+    Node * current = start;
+    Node * parent = NULL;
+    int compare = 0;
+    while (current != NULL)
+    {
+        parent = current;
+        compare = tree->compFunc(current->data, data);
+        if(compare == EQUALS) // Tree already contains data
+        {
+            *found = current;
+            return INSERT_FAILED;
+        }
+        // checks if current's data is grater/lower than data
+        current = (compare > EQUALS) ? current->left : current->right;
+    }
+    Node * z = (fresh != NULL) ? fresh : createNode(tree, data); // Creating the node to be inserted
+    *found = z;
     if(z == NULL) // checking if memory allocation worked
     {
         return INSERT_FAILED;
     }
-    Node * pot = potentialParent(tree, z);
-    z->parent = pot;
-    if(z->parent == NULL)
+    z->parent = parent;
+    if(parent == NULL)
     {
         tree->root = z;
     }
-    else if(tree->compFunc(z->data, z->parent->data)<0)
+    else if(compare > EQUALS)
     {
-        z->parent->left = z;
+        parent->left = z;
     }
     else
     {
-        z->parent->right = z;
+        parent->right = z;
     }
     balanceTree(tree, z);
     ++tree->size;
     return INSERT_SUCCESS;
 }
 
-
-
 /**
- * finds the potential parent for a node we insert to the given tree
- * @param tree
- * @param node
- * @return the father to be set in the tree
+ * add delta to the count of an item, the tree counts how many times each item was added. the tree takes
+ * ownership of data: it is either stored or freed with the tree's FreeFunc (when an equal item is already in
+ * the tree, or delta is not positive and the item is not in the tree). an item whose count drops to 0 or
+ * less is removed. runs in a single descent.
+ * @param tree: the tree to count in.
+ * @param data: the item to count.
+ * @param delta: the amount to add, may be negative.
+ * @return: the new count of the item, -1 on failure (then data still belongs to the caller).
  */
-Node * potentialParent(RBTree *tree, Node * node)
+int incrementRBTree(RBTree *tree, void *data, int delta)
 {
-    Node * current = tree -> root;
-    Node * parent = NULL;
-    int compare = 0;
-    while (current != NULL)
+    if(tree == NULL || data == NULL)
     {
-        parent = current;
-        //value from compare func
-        compare =  tree->compFunc(current->data, node -> data);
+        return INCREMENT_FAILED;
+    }
+    if(!promoteRBTree(tree)) // the counts are kept in the nodes
+    {
+        return INCREMENT_FAILED;
+    }
+    Node * found;
+    if(delta > 0)
+    {
+        if(insertBelow(tree, tree->root, data, NULL, &found))
+        {
+            found->count = delta;
+            return delta;
+        }
+        if(found == NULL)
+        {
+            return INCREMENT_FAILED;
+        }
+    }
+    else if((found = findNode(tree, data)) == NULL)
+    {
+        tree->freeFunc(data);
+        return 0;
+    }
+    if(found->data != data)
+    {
+        tree->freeFunc(data); // a duplicate of the stored item
+    }
+    found->count += delta;
+    if(found->count > 0)
+    {
+        return found->count;
+    }
+    removeNode(tree, found);
+    return 0;
+}
 
-        // checks if current's data is grater/lower than node's data
-        current = (compare > EQUALS)? current->left:current->right;
+/**
+ * set the value of a key in a map tree, in a single descent. the tree takes ownership of key and value: if
+ * the key is already in the tree, the given key is freed and the value replaces (and frees) the old one.
+ * @param tree: the map tree.
+ * @param key: the key.
+ * @param value: the new value of the key, may be NULL.
+ * @return: 0 on failure (then key and value still belong to the caller), other on success.
+ */
+int putRBTree(RBTree *tree, void *key, void *value)
+{
+    if(tree == NULL || key == NULL || !IS_MAP(tree) || !promoteRBTree(tree))
+    {
+        return 0;
     }
-    return parent;
+    Node * found;
+    if(!insertBelow(tree, tree->root, key, NULL, &found))
+    {
+        if(found == NULL)
+        {
+            return 0;
+        }
+        if(found->data != key)
+        {
+            tree->freeFunc(key); // a duplicate of the stored key
+        }
+        if(VALUE_OF(found) != NULL && VALUE_OF(found) != value)
+        {
+            tree->valueFreeFunc(VALUE_OF(found));
+        }
+    }
+    VALUE_OF(found) = value;
+    return 1;
 }
 
-Node * createNode(void * data)
+/**
+ * find the value of a key in a map tree. the value may be read or replaced in place through the returned
+ * pointer, a replaced value is not freed by the tree.
+ * @param tree: the map tree.
+ * @param key: the key to look for.
+ * @return: a pointer to the value of the key, NULL if the key is not in the tree.
+ */
+void **getRBTree(RBTree *tree, void *key)
 {
-    Node * node = (Node *) malloc(sizeof(Node));
-    if (node == NULL || data == NULL)
+    if(tree == NULL || key == NULL || !IS_MAP(tree))
     {
         return NULL;
     }
-    node->data = data;
-    node->color = RED;
-    node->right = NULL;
-    node->left = NULL;
-    node->parent = NULL;
-    return node;
+    Node * found = findNode(tree, key);
+    return (found == NULL) ? NULL : &VALUE_OF(found);
 }
 
 /**
- * check whether the tree contains this item or not.
- * @param tree: the tree to add an item to.
- * @param data: item to check.
- * @return: 0 if the item is not in the tree, other if it is.
+ * find the value of a key in a map tree, and add the key with a NULL value if it is not there, in a single
+ * descent. the tree takes ownership of key: it is either stored or freed (when an equal key is already in the
+ * tree). the caller sets the value of a new key through the returned pointer.
+ * @param tree: the map tree.
+ * @param key: the key.
+ * @return: a pointer to the value of the key, NULL on failure (then key still belongs to the caller).
  */
-int containsRBTree(RBTree *tree, void *data)
+void **getOrInsertRBTree(RBTree *tree, void *key)
 {
-    if(tree == NULL || data == NULL)
+    if(tree == NULL || key == NULL || !IS_MAP(tree) || !promoteRBTree(tree))
     {
-        return 1;
+        return NULL;
     }
-    int compare;
-    Node* current = tree->root;
-    while (current != NULL)
+    Node * found;
+    if(!insertBelow(tree, tree->root, key, NULL, &found))
     {
-        compare = tree->compFunc(current->data, data); //calls comparator func
-        if(compare > EQUALS) // checks if current's data is grater than data
-        {
-            current = current->left;
-        }
-        else if (compare < EQUALS) // checks if current's data is lower than data
+        if(found == NULL)
         {
-            current = current->right;
+            return NULL;
         }
-        else // else they are equals witch means, data is in tree
+        if(found->data != key)
         {
-            return 1;
+            tree->freeFunc(key); // a duplicate of the stored key
         }
     }
-    return 0;
+    return &VALUE_OF(found);
 }
 
 /**
- * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
- * function returns 0, the process stops.
- * @param tree: the tree with all the items.
- * @param func: the function to activate on all items.
- * @param args: more optional arguments to the function (may be null if the given function support it).
- * @return: 0 on failure, other on success.
+ * @param tree: the tree to count in.
+ * @param data: item to check.
+ * @return: the number of times the item is in the tree, 0 if it is not.
  */
-int forEachRBTree(RBTree *tree, forEachFunc func, void *args) // implement it in RBTree.c
+int countRBTree(RBTree *tree, void *data)
 {
-    if(func == NULL)
+    if(tree == NULL || data == NULL)
     {
         return 0;
     }
-    Node * start = minNodeInSubTree(tree->root);
-    int f = func(start->data, args);
-    if (!f)
+    if(IS_FLAT(tree))
+    {
+        size_t index;
+        return flatSearch(tree, data, &index);
+    }
+    Node * found = findNode(tree, data);
+    return (found == NULL) ? 0 : found->count;
+}
+
+/**
+ * remove an item from the tree. the stored item is freed with the tree's FreeFunc.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove.
+ * @return: 0 on failure, other on success. (if the item is not in the tree - failure).
+ */
+int removeFromRBTree(RBTree *tree, void *data)
+{
+    if(tree == NULL || data == NULL)
     {
         return 0;
     }
-    Node * current = findSuccessor(start);
-    while(current != NULL)
+    if(IS_FLAT(tree))
     {
-        f = func(current->data, args);
-        if (!f)
+        size_t index;
+        if(!flatSearch(tree, data, &index))
         {
             return 0;
         }
-        current = findSuccessor(current);
+        flatRemove(tree, index);
+        return 1;
+    }
+    Node * z = findNode(tree, data);
+    if(z == NULL)
+    {
+        return 0;
     }
+    removeNode(tree, z);
     return 1;
 }
 
-
 /**
- * find a successor for a node
- * @param start the node to find it's successor
- * @return start's successor
+ * puts node v in the place of node u under u's parent.
  */
-Node * findSuccessor(Node * start)
+void transplant(RBTree *tree, Node * u, Node * v)
 {
-    if(start == NULL) // checks base case
+    if(u->parent == NULL)
     {
-        return NULL;
+        tree->root = v;
     }
-    if(start->right != NULL) // if start has a right child
+    else
     {
-        return minNodeInSubTree(start->right); //returns the minimum of start's right child
+        swapChildToCorrectPos(u->parent, u, v);
     }
-    Node * parent = start->parent;
-    if(parent != NULL)
+    if(v != NULL)
     {
-        if (parent->left == start) // if start is a left child of it's parent
+        v->parent = u->parent;
+    }
+}
+
+/**
+ * unlinks a node from the tree, frees it and its data and restores the red black properties. nodes are
+ * relinked rather than having their data swapped, so the other nodes keep holding the same items.
+ * @param tree the tree to remove from
+ * @param z the node to remove
+ */
+void removeNode(RBTree *tree, Node * z)
+{
+    Node * y = z;
+    Color removedColor = y->color;
+    Node * x;
+    Node * xParent;
+    if(z->left == NULL)
+    {
+        x = z->right;
+        xParent = z->parent;
+        transplant(tree, z, z->right);
+    }
+    else if(z->right == NULL)
+    {
+        x = z->left;
+        xParent = z->parent;
+        transplant(tree, z, z->left);
+    }
+    else // z is replaced by its successor y
+    {
+        y = minNodeInSubTree(z->right);
+        removedColor = y->color;
+        x = y->right;
+        if(y->parent == z)
         {
-            return start->parent; // returns the parent
+            xParent = y;
         }
-        if (parent->right == start)
+        else
         {
-            Node *successor = parent;
-            while (successor != NULL && successor->right == start)
+            xParent = y->parent;
+            transplant(tree, y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        transplant(tree, z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->color = z->color;
+    }
+    if(removedColor == BLACK)
+    {
+        fixRemoval(tree, x, xParent);
+    }
+    if(tree->cache != NULL) // the other nodes keep their items, so only z may have to leave the cache
+    {
+        Node ** slot = &tree->cache->slots[tree->cache->hashFunc(z->data) & tree->cache->mask];
+        if(*slot == z)
+        {
+            *slot = NULL;
+        }
+    }
+    freeNode(tree, z);
+    --tree->size;
+}
+
+/**
+ * fixes the missing black node on the path to x after a removal.
+ * @param tree the tree
+ * @param x the node that took the removed node's place, may be NULL
+ * @param parent the parent of x
+ */
+void fixRemoval(RBTree *tree, Node * x, Node * parent)
+{
+    while(x != tree->root && findColor(x) == BLACK)
+    {
+        if(x == parent->left)
+        {
+            Node * sibling = parent->right;
+            if(sibling->color == RED)
             {
-                start = successor;
-                successor = start->parent;
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateLeft(tree, parent);
+                sibling = parent->right;
             }
-            return successor; // can return a pointer because successor is not a local variable
+            if(findColor(sibling->left) == BLACK && findColor(sibling->right) == BLACK)
+            {
+                sibling->color = RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if(findColor(sibling->right) == BLACK)
+            {
+                sibling->left->color = BLACK;
+                sibling->color = RED;
+                rotateRight(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = BLACK;
+            sibling->right->color = BLACK;
+            rotateLeft(tree, parent);
+        }
+        else
+        {
+            Node * sibling = parent->left;
+            if(sibling->color == RED)
+            {
+                sibling->color = BLACK;
+                parent->color = RED;
+                rotateRight(tree, parent);
+                sibling = parent->left;
+            }
+            if(findColor(sibling->left) == BLACK && findColor(sibling->right) == BLACK)
+            {
+                sibling->color = RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if(findColor(sibling->left) == BLACK)
+            {
+                sibling->right->color = BLACK;
+                sibling->color = RED;
+                rotateLeft(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = BLACK;
+            sibling->left->color = BLACK;
+            rotateRight(tree, parent);
         }
+        x = tree->root;
+    }
+    if(x != NULL)
+    {
+        x->color = BLACK;
     }
-    return NULL;
 }
 
 /**
- * Finds min node of a sub tree
- * @param head the root of the sub tree
- * @return the min node of that sub tree
+ * rotates a node down to the left, its right child takes its place.
  */
-Node * minNodeInSubTree(Node * head)
+void rotateLeft(RBTree *tree, Node * node)
 {
-    Node *start = NULL;
-    Node *current = head;
-    while(current != NULL)
+    Node * child = node->right;
+    node->right = child->left;
+    if(child->left != NULL)
     {
-        start = current;
-        current = current->left;
+        child->left->parent = node;
     }
-    return start;
+    transplant(tree, node, child);
+    child->left = node;
+    node->parent = child;
 }
 
-void freeRBTree(RBTree *tree)
+/**
+ * rotates a node down to the right, its left child takes its place.
+ */
+void rotateRight(RBTree *tree, Node * node)
 {
-    if (tree == NULL)
+    Node * child = node->left;
+    node->left = child->right;
+    if(child->right != NULL)
     {
-        return;
+        child->right->parent = node;
     }
-    freeNodesInDepth(tree, tree->root);
-    free(tree);
+    transplant(tree, node, child);
+    child->right = node;
+    node->parent = child;
 }
 
-void freeNodesInDepth(RBTree * t, Node * node)
+/**
+ * add many items to the tree. the batch is fastest when the items are sorted in ascending order: a large batch
+ * is merged with the tree and rebuilt in O(size + n), a small one is inserted starting from the previous
+ * insertion point instead of the root.
+ * @param tree: the tree to add the items to.
+ * @param items: the items to add. on success, the items that were not added (already in the tree or in the
+ * batch) are moved to the start of the array, so the caller can free them.
+ * @param n: number of items.
+ * @param duplicates: out parameter for the number of items that were not added, may be NULL.
+ * @return: 0 on failure, other on success.
+ */
+int addBatchRBTree(RBTree *tree, void **items, size_t n, size_t *duplicates)
 {
-    if(node == NULL)
+    if(tree == NULL || items == NULL)
     {
-        return;
+        return INSERT_FAILED;
     }
-    freeNodesInDepth(t, node->left);
-    freeNodesInDepth(t, node->right);
-    if (node->data != NULL)
+    char * rejected = (char *) calloc(n + 1, sizeof(char));
+    void ** reordered = (void **) malloc(sizeof(void *) * (n + 1));
+    if(rejected == NULL || reordered == NULL)
+    {
+        free(rejected);
+        free(reordered);
+        return INSERT_FAILED;
+    }
+    int sorted = 1;
+    void * first = NULL;
+    void * prev = NULL;
+    for(size_t i = 0; i < n && sorted; ++i)
+    {
+        if(items[i] != NULL)
+        {
+            sorted = (prev == NULL || tree->compFunc(prev, items[i]) <= EQUALS);
+            first = (first == NULL) ? items[i] : first;
+            prev = items[i];
+        }
+    }
+    size_t covered = 0; // the number of nodes in the range of a sorted batch, if it is merged
+    int result = 1;
+    if(IS_FLAT(tree) && tree->size + n <= tree->flatLimit)
+    {
+        // with the room reserved up front the inserts can't fail, so the batch is added as a whole or not at all
+        result = flatReserve(tree, tree->size + n);
+        for(size_t i = 0; i < n && result; ++i)
+        {
+            rejected[i] = (items[i] == NULL || !flatInsert(tree, items[i]));
+        }
+    }
+    else if(!promoteRBTree(tree))
+    {
+        result = INSERT_FAILED;
+    }
+    else if(sorted && (covered = countRange(tree, first, prev, n * MERGE_RATIO + 1)) <= n * MERGE_RATIO)
+    {
+        result = mergeSorted(tree, items, n, covered, rejected);
+    }
+    else
+    {
+        result = insertWithFinger(tree, items, n, rejected);
+    }
+    if(result)
+    {
+        // the rejected items go first, both parts keep their order
+        size_t count = 0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(rejected[i])
+            {
+                reordered[count++] = items[i];
+            }
+        }
+        if(duplicates != NULL)
+        {
+            *duplicates = count;
+        }
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(!rejected[i])
+            {
+                reordered[count++] = items[i];
+            }
+        }
+        for(size_t i = 0; i < n; ++i)
+        {
+            items[i] = reordered[i];
+        }
+    }
+    free(rejected);
+    free(reordered);
+    return result;
+}
+
+/**
+ * inserts the items one by one, each descent starts from the lowest ancestor of the previous item's node
+ * whose subtree may hold the next item. for sorted items that is close to the previous node.
+ * all the nodes are allocated before the tree is touched, so on failure it stays as it was.
+ * @param tree the tree to add the items to
+ * @param items the items to add
+ * @param n number of items
+ * @param rejected out array, set for the items that were not added
+ * @return 1 on success, 0 if a memory allocation failed
+ */
+int insertWithFinger(RBTree *tree, void **items, size_t n, char * rejected)
+{
+    Node ** fresh = (Node **) calloc(n + 1, sizeof(Node *));
+    if(fresh == NULL)
+    {
+        return 0;
+    }
+    for(size_t j = 0; j < n; ++j)
+    {
+        if(items[j] != NULL && (fresh[j] = createNode(tree, items[j])) == NULL)
+        {
+            for(size_t k = 0; k < j; ++k)
+            {
+                free(fresh[k]);
+            }
+            free(fresh);
+            return 0;
+        }
+    }
+    Node * finger = NULL;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(items[i] == NULL)
+        {
+            rejected[i] = 1;
+            continue;
+        }
+        Node * start = tree->root;
+        if(finger != NULL && tree->compFunc(finger->data, items[i]) <= EQUALS)
+        {
+            // find the lowest node above the finger whose key range holds the item. a chain of right children
+            // shares one upper bound, set by the first left link above it, so only left links are compared
+            start = finger;
+            for(Node * node = finger; node->parent != NULL; node = node->parent)
+            {
+                if(node == node->parent->left)
+                {
+                    if(tree->compFunc(node->parent->data, items[i]) > EQUALS)
+                    {
+                        break;
+                    }
+                    start = node->parent;
+                }
+            }
+        }
+        rejected[i] = !insertBelow(tree, start, items[i], fresh[i], &finger);
+        if(rejected[i])
+        {
+            free(fresh[i]);
+        }
+    }
+    free(fresh);
+    return 1;
+}
+
+/**
+ * counts the nodes between two items, walking at most limit of them.
+ * @param first the lowest item of the range (inclusive), NULL for an empty range
+ * @param last the highest item of the range (inclusive)
+ * @param limit the most nodes to walk
+ * @return the number of nodes in the range, or limit if there are at least that many
+ */
+size_t countRange(RBTree *tree, void * first, void * last, size_t limit)
+{
+    Node * start = NULL; // the lowest node that is not lower than first
+    Node * end = NULL; // the lowest node that is greater than last
+    for(Node * current = (first == NULL) ? NULL : tree->root; current != NULL;)
+    {
+        if(tree->compFunc(current->data, first) >= EQUALS)
+        {
+            start = current;
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+    for(Node * current = (start == NULL) ? NULL : tree->root; current != NULL;)
+    {
+        if(tree->compFunc(current->data, last) > EQUALS)
+        {
+            end = current;
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+    size_t count = 0;
+    for(Node * current = start; current != end && count < limit; current = findSuccessor(current))
+    {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * merges sorted items with the nodes of the tree in their range: the range is split out of the tree, its nodes
+ * and the items are relinked into a balanced subtree, and that is joined back, in O(covered + n + log size).
+ * all the nodes are allocated before the tree is touched, so on failure it stays as it was.
+ * @param tree the tree to add the items to
+ * @param items the items to add, sorted in ascending order
+ * @param n number of items
+ * @param covered the number of nodes between the first and the last item (see countRange)
+ * @param rejected out array, set for the items that were not added
+ * @return 1 on success, 0 if a memory allocation failed
+ */
+int mergeSorted(RBTree *tree, void **items, size_t n, size_t covered, char * rejected)
+{
+    Node ** merged = (Node **) malloc(sizeof(Node *) * (covered + n + 1));
+    Node ** fresh = (Node **) calloc(n + 1, sizeof(Node *));
+    if(merged == NULL || fresh == NULL)
+    {
+        free(merged);
+        free(fresh);
+        return 0;
+    }
+    void * first = NULL;
+    void * last = NULL;
+    for(size_t j = 0; j < n; ++j)
+    {
+        if(items[j] != NULL && (fresh[j] = createNode(tree, items[j])) == NULL)
+        {
+            for(size_t k = 0; k < j; ++k)
+            {
+                free(fresh[k]);
+            }
+            free(merged);
+            free(fresh);
+            return 0;
+        }
+        first = (first == NULL) ? items[j] : first;
+        last = (items[j] == NULL) ? last : items[j];
+    }
+    Node * less = NULL;
+    Node * middle = NULL;
+    Node * greater = tree->root;
+    int lessHeight = 0;
+    int middleHeight = 0;
+    int greaterHeight = blackHeight(tree->root);
+    if(first != NULL)
+    {
+        Node * found = splitAt(greater, greaterHeight, first, tree->compFunc, &less, &lessHeight, &middle,
+                               &middleHeight);
+        if(found != NULL)
+        {
+            middle = joinWithPivot(NULL, 0, found, middle, middleHeight, &middleHeight);
+        }
+        found = splitAt(middle, middleHeight, last, tree->compFunc, &middle, &middleHeight, &greater,
+                        &greaterHeight);
+        if(found != NULL)
+        {
+            middle = joinWithPivot(middle, middleHeight, found, NULL, 0, &middleHeight);
+        }
+    }
+    size_t count = 0;
+    int compare = EQUALS;
+    last = NULL; // the last item taken from the batch
+    Node * old = minNodeInSubTree(middle);
+    for(size_t j = 0; j < n; ++j)
+    {
+        if(items[j] == NULL)
+        {
+            rejected[j] = 1;
+            continue;
+        }
+        while(old != NULL && (compare = tree->compFunc(old->data, items[j])) < EQUALS)
+        {
+            merged[count++] = old;
+            old = findSuccessor(old);
+        }
+        if((old != NULL && compare == EQUALS) || (last != NULL && tree->compFunc(last, items[j]) == EQUALS))
+        {
+            rejected[j] = 1;
+            free(fresh[j]);
+            continue;
+        }
+        merged[count++] = fresh[j];
+        last = items[j];
+    }
+    for(; old != NULL; old = findSuccessor(old))
+    {
+        merged[count++] = old;
+    }
+    middle = linkBalanced(merged, 0, count, NULL, 0, redDepthFor(count));
+    middle = joinTwo(middle, blackHeight(middle), greater, greaterHeight, &middleHeight);
+    tree->root = joinTwo(less, lessHeight, middle, middleHeight, &lessHeight);
+    tree->size += count - covered;
+    free(merged);
+    free(fresh);
+    return 1;
+}
+
+/**
+ * allocates a red node for an item, with room for a NULL value if the tree is a map.
+ */
+Node * createNode(RBTree *tree, void * data)
+{
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    Node * node = (Node *) malloc(IS_MAP(tree) ? sizeof(MapNode) : sizeof(Node));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    if (IS_MAP(tree))
+    {
+        VALUE_OF(node) = NULL;
+    }
+    node->data = data;
+    node->count = 1;
+    node->color = RED;
+    node->right = NULL;
+    node->left = NULL;
+    node->parent = NULL;
+    return node;
+}
+
+/**
+ * frees a node together with its item and its value.
+ */
+void freeNode(RBTree *tree, Node * node)
+{
+    tree->freeFunc(node->data);
+    if(IS_MAP(tree) && VALUE_OF(node) != NULL)
     {
-        t->freeFunc(node->data); // freeing data of a node
-        node->data = NULL;
+        tree->valueFreeFunc(VALUE_OF(node));
     }
     free(node);
-}
\ No newline at end of file
+}
+
+/**
+ * check whether the tree contains this item or not.
+ * @param tree: the tree to add an item to.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsRBTree(RBTree *tree, void *data)
+{
+    if(tree == NULL || data == NULL)
+    {
+        return 1;
+    }
+    if(IS_FLAT(tree))
+    {
+        size_t index;
+        return flatSearch(tree, data, &index);
+    }
+    return findNode(tree, data) != NULL;
+}
+
+/**
+ * find the item of the tree that is equal to data.
+ * @param tree: the tree to search in.
+ * @param data: item to look for.
+ * @return: the stored item, NULL if the item is not in the tree.
+ */
+void *findRBTree(RBTree *tree, void *data)
+{
+    if(tree == NULL || data == NULL)
+    {
+        return NULL;
+    }
+    if(IS_FLAT(tree))
+    {
+        size_t index;
+        return flatSearch(tree, data, &index) ? tree->flat[index] : NULL;
+    }
+    Node * found = findNode(tree, data);
+    return (found == NULL) ? NULL : found->data;
+}
+
+/**
+ * finds the node holding an item equal to data.
+ * @param tree the tree to search in
+ * @param data the item to look for
+ * @return the node, NULL if the item is not in the tree
+ */
+Node * findNode(RBTree *tree, void *data)
+{
+    LookupCache * cache = tree->cache;
+    Node ** slot = NULL;
+    if(cache != NULL)
+    {
+        slot = &cache->slots[cache->hashFunc(data) & cache->mask];
+        if(*slot != NULL && tree->compFunc((*slot)->data, data) == EQUALS)
+        {
+            ++cache->hits;
+            return *slot;
+        }
+        ++cache->misses;
+    }
+    int compare;
+    Node* current = tree->root;
+    while (current != NULL)
+    {
+        compare = tree->compFunc(current->data, data); //calls comparator func
+        if(compare > EQUALS) // checks if current's data is grater than data
+        {
+            current = current->left;
+        }
+        else if (compare < EQUALS) // checks if current's data is lower than data
+        {
+            current = current->right;
+        }
+        else // else they are equals witch means, data is in tree
+        {
+            if(slot != NULL)
+            {
+                *slot = current;
+            }
+            return current;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * check for many items at once whether the tree contains them. the lookups advance in lockstep, one level
+ * at a time, so the cache misses of different lookups overlap.
+ * @param tree: the tree to search in.
+ * @param keys: the items to check.
+ * @param n: number of items.
+ * @param results: out array of n cells, each is set to 0 if the matching item is not in the tree, other if it is.
+ * @return: 0 on failure, other on success.
+ */
+int containsBatchRBTree(RBTree *tree, void **keys, size_t n, int *results)
+{
+    if(tree == NULL || keys == NULL || results == NULL)
+    {
+        return 0;
+    }
+    if(IS_FLAT(tree))
+    {
+        for(size_t i = 0; i < n; ++i)
+        {
+            results[i] = (keys[i] != NULL) && containsRBTree(tree, keys[i]);
+        }
+        return 1;
+    }
+    Node * cursors[BATCH_GROUP];
+    for(size_t base = 0; base < n; base += BATCH_GROUP)
+    {
+        int count = (n - base < BATCH_GROUP) ? (int) (n - base) : BATCH_GROUP;
+        int active = 0;
+        for(int i = 0; i < count; ++i)
+        {
+            results[base + i] = NOT_FOUND;
+            cursors[i] = (keys[base + i] == NULL) ? NULL : tree->root;
+            active += (cursors[i] != NULL);
+        }
+        while(active > 0) // every round moves each unfinished lookup one level down
+        {
+            active = 0;
+            for(int i = 0; i < count; ++i)
+            {
+                Node * current = cursors[i];
+                if(current == NULL)
+                {
+                    continue;
+                }
+                int compare = tree->compFunc(current->data, keys[base + i]);
+                if(compare == EQUALS)
+                {
+                    results[base + i] = FOUND;
+                    cursors[i] = NULL;
+                    continue;
+                }
+                current = (compare > EQUALS) ? current->left : current->right;
+                if(current != NULL)
+                {
+                    PREFETCH(current); // loaded while the other lookups of the group compare
+                    ++active;
+                }
+                cursors[i] = current;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * same as containsBatchRBTree, for keys sorted in ascending order. each lookup continues from the path of the
+ * previous one instead of the root. unsorted keys give correct results, only slower.
+ * @param tree: the tree to search in.
+ * @param keys: the items to check.
+ * @param n: number of items.
+ * @param results: out array of n cells, each is set to 0 if the matching item is not in the tree, other if it is.
+ * @return: 0 on failure, other on success.
+ */
+int containsSortedBatchRBTree(RBTree *tree, void **keys, size_t n, int *results)
+{
+    if(tree == NULL || keys == NULL || results == NULL)
+    {
+        return 0;
+    }
+    if(IS_FLAT(tree))
+    {
+        return containsBatchRBTree(tree, keys, n, results);
+    }
+    Node * path[MAX_DEPTH];
+    void * bounds[MAX_DEPTH]; // bounds[i] is greater than all of path[i]'s subtree, NULL if there is no bound
+    int depth = 0;
+    void * prev = NULL;
+    for(size_t i = 0; i < n; ++i)
+    {
+        void * key = keys[i];
+        results[i] = NOT_FOUND;
+        if(key == NULL || tree->root == NO_ROOT)
+        {
+            continue;
+        }
+        if(prev != NULL && tree->compFunc(prev, key) > EQUALS) // out of order, start over from the root
+        {
+            depth = 0;
+        }
+        prev = key;
+        // climb until the key fits into the subtree at the top of the path
+        void * checked = NULL;
+        int outside = 0;
+        while(depth > 0 && bounds[depth - 1] != NULL)
+        {
+            if(bounds[depth - 1] != checked) // consecutive levels share most of their bounds
+            {
+                checked = bounds[depth - 1];
+                outside = tree->compFunc(checked, key) <= EQUALS;
+            }
+            if(!outside)
+            {
+                break;
+            }
+            --depth;
+        }
+        if(depth == 0)
+        {
+            path[0] = tree->root;
+            bounds[0] = NULL;
+            depth = 1;
+        }
+        Node * current = path[depth - 1];
+        while(1)
+        {
+            int compare = tree->compFunc(current->data, key);
+            if(compare == EQUALS)
+            {
+                results[i] = FOUND;
+                break;
+            }
+            Node * next = (compare > EQUALS) ? current->left : current->right;
+            if(next == NULL)
+            {
+                break;
+            }
+            path[depth] = next;
+            bounds[depth] = (compare > EQUALS) ? current->data : bounds[depth - 1];
+            ++depth;
+            current = next;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRBTree(RBTree *tree, forEachFunc func, void *args) // implement it in RBTree.c
+{
+    if(func == NULL)
+    {
+        return 0;
+    }
+    if(IS_FLAT(tree))
+    {
+        for(size_t i = 0; i < tree->size; ++i)
+        {
+            if(!func(tree->flat[i], args))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    Node * start = minNodeInSubTree(tree->root);
+    int f = func(start->data, args);
+    if (!f)
+    {
+        return 0;
+    }
+    Node * current = findSuccessor(start);
+    while(current != NULL)
+    {
+        f = func(current->data, args);
+        if (!f)
+        {
+            return 0;
+        }
+        current = findSuccessor(current);
+    }
+    return 1;
+}
+
+
+/**
+ * Activate a function on each item of the tree in the range [from, to), in ascending order. if one of the
+ * activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param from: the lowest item of the range (inclusive), NULL for no lower bound. it does not have to be in the tree.
+ * @param to: the end of the range (exclusive), NULL for no upper bound. it does not have to be in the tree.
+ * @param func: the function to activate on the items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRangeRBTree(RBTree *tree, void *from, void *to, forEachFunc func, void *args)
+{
+    if(tree == NULL || func == NULL)
+    {
+        return 0;
+    }
+    if(IS_FLAT(tree))
+    {
+        size_t index = 0;
+        if(from != NULL)
+        {
+            flatSearch(tree, from, &index);
+        }
+        for(; index < tree->size && (to == NULL || tree->compFunc(tree->flat[index], to) < EQUALS); ++index)
+        {
+            if(!func(tree->flat[index], args))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    Node * start = NULL; // the lowest node that is not lower than from
+    if(from == NULL)
+    {
+        start = minNodeInSubTree(tree->root);
+    }
+    for(Node * current = (from == NULL) ? NULL : tree->root; current != NULL;)
+    {
+        if(tree->compFunc(current->data, from) >= EQUALS)
+        {
+            start = current;
+            current = current->left;
+        }
+        else
+        {
+            current = current->right;
+        }
+    }
+    for(Node * current = start; current != NULL; current = findSuccessor(current))
+    {
+        if(to != NULL && tree->compFunc(current->data, to) >= EQUALS)
+        {
+            break;
+        }
+        if(!func(current->data, args))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * same as forEachRBTree, and also passes the count of each item (see incrementRBTree).
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachCountRBTree(RBTree *tree, forEachCountFunc func, void *args)
+{
+    if(tree == NULL || func == NULL)
+    {
+        return 0;
+    }
+    for(size_t i = 0; IS_FLAT(tree) && i < tree->size; ++i)
+    {
+        if(!func(tree->flat[i], 1, args))
+        {
+            return 0;
+        }
+    }
+    for(Node * current = minNodeInSubTree(tree->root); current != NULL; current = findSuccessor(current))
+    {
+        if(!func(current->data, current->count, args))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * same as forEachRBTree for a map tree, and also passes the value of each key. the values may be changed in
+ * place.
+ * @param tree: the map tree.
+ * @param func: the function to activate on all the keys.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachPairRBTree(RBTree *tree, forEachPairFunc func, void *args)
+{
+    if(tree == NULL || func == NULL || !IS_MAP(tree))
+    {
+        return 0;
+    }
+    for(Node * current = minNodeInSubTree(tree->root); current != NULL; current = findSuccessor(current))
+    {
+        if(!func(current->data, VALUE_OF(current), args))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * find a successor for a node
+ * @param start the node to find it's successor
+ * @return start's successor
+ */
+Node * findSuccessor(Node * start)
+{
+    if(start == NULL) // checks base case
+    {
+        return NULL;
+    }
+    if(start->right != NULL) // if start has a right child
+    {
+        return minNodeInSubTree(start->right); //returns the minimum of start's right child
+    }
+    Node * parent = start->parent;
+    if(parent != NULL)
+    {
+        if (parent->left == start) // if start is a left child of it's parent
+        {
+            return start->parent; // returns the parent
+        }
+        if (parent->right == start)
+        {
+            Node *successor = parent;
+            while (successor != NULL && successor->right == start)
+            {
+                start = successor;
+                successor = start->parent;
+            }
+            return successor; // can return a pointer because successor is not a local variable
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Finds min node of a sub tree
+ * @param head the root of the sub tree
+ * @return the min node of that sub tree
+ */
+Node * minNodeInSubTree(Node * head)
+{
+    Node *start = NULL;
+    Node *current = head;
+    while(current != NULL)
+    {
+        start = current;
+        current = current->left;
+    }
+    return start;
+}
+
+/**
+ * make a copy of the tree with the same shape, colors and counts, in O(n) and without comparing items. each
+ * item is copied with copyFunc, and the copy gets the same flat limit and lookup cache settings.
+ * @param tree: the tree to copy, it is not changed.
+ * @param copyFunc: a function to copy an item, the copies must compare like the originals.
+ * @return: a pointer to the new tree, NULL on failure (or for a map tree, that can not be copied).
+ */
+RBTree *cloneRBTree(RBTree *tree, CopyFunc copyFunc)
+{
+    if(tree == NULL || copyFunc == NULL || IS_MAP(tree))
+    {
+        return NULL;
+    }
+    RBTree * clone = newRBTree(tree->compFunc, tree->freeFunc);
+    if(clone == NULL)
+    {
+        return NULL;
+    }
+    clone->flatLimit = tree->flatLimit;
+    if(tree->cache != NULL && !setCacheRBTree(clone, tree->cache->hashFunc, tree->cache->mask + 1))
+    {
+        freeRBTree(clone);
+        return NULL;
+    }
+    if(IS_FLAT(tree))
+    {
+        clone->flat = (void **) malloc(sizeof(void *) * (tree->flatCapacity + 1));
+        if(clone->flat == NULL)
+        {
+            freeRBTree(clone);
+            return NULL;
+        }
+        clone->flatCapacity = tree->flatCapacity;
+        for(; clone->size < tree->size; ++clone->size)
+        {
+            if((clone->flat[clone->size] = copyFunc(tree->flat[clone->size])) == NULL)
+            {
+                freeRBTree(clone);
+                return NULL;
+            }
+        }
+        return clone;
+    }
+    int failed = 0;
+    clone->root = cloneNodes(clone, tree->root, NULL, copyFunc, &failed);
+    if(failed) // clone holds what was copied so far
+    {
+        freeRBTree(clone);
+        return NULL;
+    }
+    return clone;
+}
+
+/**
+ * copies a subtree node by node. stops copying after the first failure.
+ * @param clone the new tree, its size counts the copied nodes
+ * @param node the root of the subtree to copy
+ * @param parent the parent of the copy
+ * @param failed set to 1 if a copy or an allocation failed
+ * @return the root of the copy
+ */
+Node * cloneNodes(RBTree *clone, Node * node, Node * parent, CopyFunc copyFunc, int * failed)
+{
+    if(node == NULL || *failed)
+    {
+        return NULL;
+    }
+    void * data = copyFunc(node->data);
+    Node * copy = (data == NULL) ? NULL : createNode(clone, data);
+    if(copy == NULL)
+    {
+        if(data != NULL)
+        {
+            clone->freeFunc(data);
+        }
+        *failed = 1;
+        return NULL;
+    }
+    ++clone->size;
+    copy->parent = parent;
+    copy->color = node->color;
+    copy->count = node->count;
+    copy->left = cloneNodes(clone, node->left, copy, copyFunc, failed);
+    copy->right = cloneNodes(clone, node->right, copy, copyFunc, failed);
+    return copy;
+}
+
+/**
+ * @param tree: the tree to measure.
+ * @param itemSize: a function to measure the memory an item owns, may be NULL to count only the tree itself.
+ * @param valueSize: a function to measure the memory a value of a map tree owns, may be NULL.
+ * @return: the number of bytes used by the tree: its nodes or flat array, its lookup cache and the payloads
+ * that were measured.
+ */
+size_t memoryUsageRBTree(RBTree *tree, SizeFunc itemSize, SizeFunc valueSize)
+{
+    if(tree == NULL)
+    {
+        return 0;
+    }
+    size_t bytes = sizeof(RBTree);
+    if(tree->cache != NULL)
+    {
+        bytes += sizeof(LookupCache) + sizeof(Node *) * (tree->cache->mask + 1);
+    }
+    if(IS_FLAT(tree))
+    {
+        bytes += sizeof(void *) * tree->flatCapacity;
+        for(size_t i = 0; itemSize != NULL && i < tree->size; ++i)
+        {
+            bytes += itemSize(tree->flat[i]);
+        }
+        return bytes;
+    }
+    bytes += (IS_MAP(tree) ? sizeof(MapNode) : sizeof(Node)) * tree->size;
+    if(itemSize == NULL && valueSize == NULL)
+    {
+        return bytes;
+    }
+    for(Node * current = minNodeInSubTree(tree->root); current != NULL; current = findSuccessor(current))
+    {
+        bytes += (itemSize == NULL) ? 0 : itemSize(current->data);
+        bytes += (valueSize == NULL || !IS_MAP(tree) || VALUE_OF(current) == NULL) ? 0 : valueSize(VALUE_OF(current));
+    }
+    return bytes;
+}
+
+void freeRBTree(RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+    for(size_t i = 0; IS_FLAT(tree) && i < tree->size; ++i)
+    {
+        tree->freeFunc(tree->flat[i]);
+    }
+    free(tree->flat);
+    freeNodesInDepth(tree, tree->root);
+    freeCache(tree);
+    free(tree);
+}
+
+void freeNodesInDepth(RBTree * t, Node * node)
+{
+    if(node == NULL)
+    {
+        return;
+    }
+    freeNodesInDepth(t, node->left);
+    freeNodesInDepth(t, node->right);
+    freeNode(t, node);
+}
+
+/**
+ * finds the depth at which the nodes of a balanced tree of n nodes should be red.
+ * @param n the number of nodes
+ * @return the depth of the last level, or -1 if the tree is perfect and can be all black
+ */
+int redDepthFor(size_t n)
+{
+    int depth = 0;
+    size_t full = 1; // the number of nodes in a perfect tree of depth + 1 levels
+    while (full < n)
+    {
+        ++depth;
+        full = 2 * full + 1;
+    }
+    return (full == n) ? -1 : depth;
+}
+
+/**
+ * links the given nodes (sorted by their data) into a balanced subtree. all the levels are black
+ * except for a partial last level which is red, so every path has the same number of black nodes.
+ * @param nodes the nodes to link
+ * @param lo first index of the subtree (inclusive)
+ * @param hi last index of the subtree (exclusive)
+ * @param parent the parent of the subtree's root
+ * @param depth the depth of the subtree's root
+ * @param redDepth the depth of red nodes
+ * @return the root of the subtree
+ */
+Node * linkBalanced(Node ** nodes, size_t lo, size_t hi, Node * parent, int depth, int redDepth)
+{
+    if(lo >= hi)
+    {
+        return NULL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    Node * node = nodes[mid];
+    node->parent = parent;
+    node->color = (depth == redDepth) ? RED : BLACK;
+    node->left = linkBalanced(nodes, lo, mid, node, depth + 1, redDepth);
+    node->right = linkBalanced(nodes, mid + 1, hi, node, depth + 1, redDepth);
+    return node;
+}
+
+/**
+ * builds a valid red black tree from sorted items in O(n), without calling the comparator.
+ * @param items the items sorted in ascending order with no duplicates
+ * @param n number of items
+ * @param root out parameter for the root of the new tree
+ * @return 1 on success, 0 if a memory allocation failed (no node is left allocated)
+ */
+int buildFromSorted(RBTree *tree, void ** items, size_t n, Node ** root)
+{
+    *root = NO_ROOT;
+    if(n == EMPTY_TREE)
+    {
+        return 1;
+    }
+    Node ** nodes = (Node **) malloc(sizeof(Node *) * n);
+    if(nodes == NULL)
+    {
+        return 0;
+    }
+    for(size_t i = 0; i < n; ++i)
+    {
+        nodes[i] = createNode(tree, items[i]);
+        if(nodes[i] == NULL)
+        {
+            for(size_t j = 0; j < i; ++j)
+            {
+                free(nodes[j]);
+            }
+            free(nodes);
+            return 0;
+        }
+    }
+    *root = linkBalanced(nodes, 0, n, NULL, 0, redDepthFor(n));
+    free(nodes);
+    return 1;
+}
+
+/**
+ * places the sorted items in Eytzinger order by an in-order walk over the implicit tree.
+ * @param sorted the items in ascending order
+ * @param items the Eytzinger array (1 based)
+ * @param n number of items
+ * @param k the current slot
+ * @param next index of the next sorted item to place
+ */
+void fillEytzinger(void ** sorted, void ** items, size_t n, size_t k, size_t * next)
+{
+    if(k > n)
+    {
+        return;
+    }
+    fillEytzinger(sorted, items, n, 2 * k, next);
+    items[k] = sorted[(*next)++];
+    fillEytzinger(sorted, items, n, 2 * k + 1, next);
+}
+
+/**
+ * the inverse of fillEytzinger, reads the items of an Eytzinger array in ascending order.
+ */
+void collectEytzinger(void ** items, void ** sorted, size_t n, size_t k, size_t * next)
+{
+    if(k > n)
+    {
+        return;
+    }
+    collectEytzinger(items, sorted, n, 2 * k, next);
+    sorted[(*next)++] = items[k];
+    collectEytzinger(items, sorted, n, 2 * k + 1, next);
+}
+
+/**
+ * convert a tree into a read-only array layout that is faster to search. the items move to the frozen
+ * tree and the given tree is freed (on failure the tree is left untouched). the counts of the items are kept
+ * for thawRBTree.
+ * @param tree: the tree to freeze.
+ * @return: a pointer to the frozen tree, NULL on failure.
+ */
+FrozenRBTree *freezeRBTree(RBTree *tree)
+{
+    if(tree == NULL || IS_MAP(tree)) // a frozen tree has no room for values
+    {
+        return NULL;
+    }
+    FrozenRBTree * frozen = (FrozenRBTree *) malloc(sizeof(FrozenRBTree));
+    void ** sorted = (void **) malloc(sizeof(void *) * (tree->size + FIRST_SLOT));
+    Node ** nodes = (Node **) malloc(sizeof(Node *) * (tree->size + FIRST_SLOT));
+    if(frozen == NULL || sorted == NULL || nodes == NULL)
+    {
+        free(frozen);
+        free(sorted);
+        free(nodes);
+        return NULL;
+    }
+    frozen->items = (void **) malloc(sizeof(void *) * (tree->size + FIRST_SLOT));
+    if(frozen->items == NULL)
+    {
+        free(frozen);
+        free(sorted);
+        free(nodes);
+        return NULL;
+    }
+    frozen->counts = NULL;
+    size_t n = 0;
+    for(; IS_FLAT(tree) && n < tree->size; ++n)
+    {
+        sorted[n] = tree->flat[n];
+    }
+    size_t numNodes = 0;
+    for(Node * current = minNodeInSubTree(tree->root); current != NULL; current = findSuccessor(current))
+    {
+        nodes[numNodes++] = current;
+        sorted[n++] = current->data;
+        if(current->count != 1 && frozen->counts == NULL)
+        {
+            frozen->counts = (int *) malloc(sizeof(int) * (tree->size + FIRST_SLOT));
+            if(frozen->counts == NULL)
+            {
+                free(frozen->items);
+                free(frozen);
+                free(sorted);
+                free(nodes);
+                return NULL;
+            }
+        }
+    }
+    for(size_t i = 0; frozen->counts != NULL && i < numNodes; ++i)
+    {
+        frozen->counts[i] = nodes[i]->count; // a counted tree is never flat, so the nodes are all the items
+    }
+    size_t next = 0;
+    fillEytzinger(sorted, frozen->items, n, FIRST_SLOT, &next);
+    frozen->compFunc = tree->compFunc;
+    frozen->freeFunc = tree->freeFunc;
+    frozen->size = n;
+    for(size_t i = 0; i < numNodes; ++i)
+    {
+        free(nodes[i]); // the data now belongs to the frozen tree
+    }
+    free(nodes);
+    free(sorted);
+    free(tree->flat);
+    freeCache(tree);
+    free(tree);
+    return frozen;
+}
+
+/**
+ * check whether the frozen tree contains this item. the descent is a branch free lower bound search:
+ * each level moves to 2k or 2k + 1 by the comparator result, and the equality is checked once at the end.
+ * the slots and the items of the levels below are prefetched, since every level is a cache miss otherwise.
+ * @param frozen: the frozen tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsFrozenRBTree(FrozenRBTree *frozen, void *data)
+{
+    if(frozen == NULL || data == NULL)
+    {
+        return 0;
+    }
+    void ** items = frozen->items;
+    size_t n = frozen->size;
+    size_t k = FIRST_SLOT;
+    while(k <= n)
+    {
+        PREFETCH(items + SLOTS_PER_LINE * k); // the slots of the next 3 levels share a cache line
+        if(4 * k + 3 <= n)
+        {
+            // the items behind the slots miss as well. the slots of the grandchildren were prefetched a level
+            // ago, so their items can load while this level and the next one compare
+            PREFETCH(items[4 * k]);
+            PREFETCH(items[4 * k + 1]);
+            PREFETCH(items[4 * k + 2]);
+            PREFETCH(items[4 * k + 3]);
+        }
+        k = 2 * k + (frozen->compFunc(items[k], data) < EQUALS);
+    }
+    // drop the right turns taken after the last left turn, what's left is the lower bound
+    while(k & 1)
+    {
+        k >>= 1;
+    }
+    k >>= 1;
+    return k != 0 && frozen->compFunc(items[k], data) == EQUALS;
+}
+
+/**
+ * convert a frozen tree back into a mutable tree in O(n). the items move to the new tree with their counts
+ * and the frozen tree is freed (on failure the frozen tree is left untouched).
+ * @param frozen: the frozen tree to thaw.
+ * @return: a pointer to the new tree, NULL on failure.
+ */
+RBTree *thawRBTree(FrozenRBTree *frozen)
+{
+    if(frozen == NULL)
+    {
+        return NULL;
+    }
+    RBTree * tree = newRBTree(frozen->compFunc, frozen->freeFunc);
+    void ** sorted = (void **) malloc(sizeof(void *) * (frozen->size + FIRST_SLOT));
+    if(tree == NULL || sorted == NULL)
+    {
+        free(tree);
+        free(sorted);
+        return NULL;
+    }
+    size_t next = 0;
+    collectEytzinger(frozen->items, sorted, frozen->size, FIRST_SLOT, &next);
+    if(!buildFromSorted(tree, sorted, frozen->size, &tree->root))
+    {
+        free(tree);
+        free(sorted);
+        return NULL;
+    }
+    tree->size = frozen->size;
+    size_t i = 0;
+    for(Node * current = minNodeInSubTree(tree->root); frozen->counts != NULL && current != NULL;
+        current = findSuccessor(current))
+    {
+        current->count = frozen->counts[i++];
+    }
+    free(sorted);
+    free(frozen->counts);
+    free(frozen->items);
+    free(frozen);
+    return tree;
+}
+
+/**
+ * free all memory of the frozen tree, including its items.
+ * @param frozen: the frozen tree to free.
+ */
+void freeFrozenRBTree(FrozenRBTree *frozen)
+{
+    if(frozen == NULL)
+    {
+        return;
+    }
+    for(size_t k = FIRST_SLOT; k <= frozen->size; ++k)
+    {
+        frozen->freeFunc(frozen->items[k]);
+    }
+    free(frozen->counts);
+    free(frozen->items);
+    free(frozen);
+}
+
+
+/**
+ * counts the black nodes on the way from a root down to a leaf.
+ * @param root the root of a valid red black subtree
+ * @return the black height of the subtree
+ */
+int blackHeight(Node * root)
+{
+    int height = 0;
+    for(Node * current = root; current != NULL; current = current->left)
+    {
+        height += (current->color == BLACK);
+    }
+    return height;
+}
+
+/**
+ * the black height a child subtree gets once it is detached (see detachSubTree). the heights of the join and
+ * split helpers are always those of detached subtrees, and are passed down instead of counted again, so
+ * each join costs only the difference of the heights.
+ * @param parent a node
+ * @param height the black height of parent's subtree, with parent black
+ * @param child a child of parent, may be NULL
+ * @return the black height of child's subtree with child black
+ */
+int childHeight(Node * parent, int height, Node * child)
+{
+    return height - (parent->color == BLACK) + (child != NULL && child->color == RED);
+}
+
+/**
+ * detaches a subtree from its parent and colors its root black, which keeps it a valid red black tree.
+ * @param root the root of the subtree
+ * @return the root
+ */
+Node * detachSubTree(Node * root)
+{
+    if(root != NULL)
+    {
+        root->parent = NULL;
+        root->color = BLACK;
+    }
+    return root;
+}
+
+/**
+ * joins two trees and a pivot node, where all of left < pivot < all of right. the pivot is hung on the spine
+ * of the higher tree at the black height of the lower one, and then balanced like a newly inserted node.
+ * runs in O(|leftHeight - rightHeight| + 1).
+ * @param left a valid red black tree, may be NULL
+ * @param leftHeight the black height of left
+ * @param pivot a single node
+ * @param right a valid red black tree, may be NULL
+ * @param rightHeight the black height of right
+ * @param height out parameter for the black height of the joined tree
+ * @return the root of the joined tree
+ */
+Node * joinWithPivot(Node * left, int leftHeight, Node * pivot, Node * right, int rightHeight, int * height)
+{
+    left = detachSubTree(left);
+    right = detachSubTree(right);
+    pivot->parent = NULL;
+    if(leftHeight == rightHeight)
+    {
+        pivot->color = BLACK;
+        pivot->left = left;
+        pivot->right = right;
+        if(left != NULL)
+        {
+            left->parent = pivot;
+        }
+        if(right != NULL)
+        {
+            right->parent = pivot;
+        }
+        *height = leftHeight + 1;
+        return pivot;
+    }
+    RBTree joined; // only the root is used by the balancing
+    Node * current;
+    Node * parent = NULL;
+    pivot->color = RED;
+    if(leftHeight > rightHeight)
+    {
+        *height = leftHeight;
+        joined.root = left;
+        current = left;
+        while(current != NULL && (current->color == RED || leftHeight > rightHeight))
+        {
+            leftHeight -= (current->color == BLACK);
+            parent = current;
+            current = current->right;
+        }
+        pivot->left = current;
+        pivot->right = right;
+        parent->right = pivot;
+    }
+    else
+    {
+        *height = rightHeight;
+        joined.root = right;
+        current = right;
+        while(current != NULL && (current->color == RED || rightHeight > leftHeight))
+        {
+            rightHeight -= (current->color == BLACK);
+            parent = current;
+            current = current->left;
+        }
+        pivot->left = left;
+        pivot->right = current;
+        parent->left = pivot;
+    }
+    pivot->parent = parent;
+    if(pivot->left != NULL)
+    {
+        pivot->left->parent = pivot;
+    }
+    if(pivot->right != NULL)
+    {
+        pivot->right->parent = pivot;
+    }
+    // the fixup of balanceTree, which also tells whether the red reached the root and the tree grew
+    Node * z = pivot;
+    while(z != joined.root && z->parent->color == RED)
+    {
+        Node * uncle = findUncle(z);
+        if(findColor(uncle) == RED)
+        {
+            Node * grandpa = uncle->parent;
+            fixColors(z->parent, uncle, grandpa);
+            z = grandpa;
+        }
+        else
+        {
+            handleRotation(z, &joined);
+            break;
+        }
+    }
+    if(joined.root->color == RED)
+    {
+        joined.root->color = BLACK;
+        ++*height;
+    }
+    return joined.root;
+}
+
+/**
+ * splits the maximal node out of a tree.
+ * @param root the root of a valid red black tree, not NULL
+ * @param height the black height of the tree
+ * @param last out parameter for the detached maximal node
+ * @param restHeight out parameter for the black height of the remaining tree
+ * @return the root of the remaining tree
+ */
+Node * splitLast(Node * root, int height, Node ** last, int * restHeight)
+{
+    Node * left = root->left;
+    Node * right = root->right;
+    int leftHeight = childHeight(root, height, left);
+    if(right == NULL)
+    {
+        *last = root;
+        *restHeight = leftHeight;
+        return detachSubTree(left);
+    }
+    int rightHeight = childHeight(root, height, right);
+    Node * rest = splitLast(detachSubTree(right), rightHeight, last, &rightHeight);
+    return joinWithPivot(left, leftHeight, root, rest, rightHeight, restHeight);
+}
+
+/**
+ * joins two trees where all of left < all of right.
+ * @param height out parameter for the black height of the joined tree
+ * @return the root of the joined tree
+ */
+Node * joinTwo(Node * left, int leftHeight, Node * right, int rightHeight, int * height)
+{
+    if(left == NULL)
+    {
+        *height = rightHeight;
+        return detachSubTree(right);
+    }
+    if(right == NULL)
+    {
+        *height = leftHeight;
+        return detachSubTree(left);
+    }
+    Node * pivot;
+    left = splitLast(detachSubTree(left), leftHeight, &pivot, &leftHeight);
+    return joinWithPivot(left, leftHeight, pivot, right, rightHeight, height);
+}
+
+/**
+ * splits a tree by an item, in O(log n): the heights of the joins along the path add up to the height of
+ * the tree.
+ * @param root the root of a valid red black tree
+ * @param height the black height of the tree
+ * @param data the item to split by
+ * @param compFunc the comparator of the tree
+ * @param less out parameter for the tree of the items lower than data
+ * @param lessHeight out parameter for the black height of less
+ * @param greater out parameter for the tree of the items greater than data
+ * @param greaterHeight out parameter for the black height of greater
+ * @return the detached node equal to data, NULL if there is none
+ */
+Node * splitAt(Node * root, int height, void * data, CompareFunc compFunc, Node ** less, int * lessHeight,
+               Node ** greater, int * greaterHeight)
+{
+    if(root == NULL)
+    {
+        *less = *greater = NULL;
+        *lessHeight = *greaterHeight = 0;
+        return NULL;
+    }
+    int leftHeight = childHeight(root, height, root->left);
+    int rightHeight = childHeight(root, height, root->right);
+    Node * left = detachSubTree(root->left);
+    Node * right = detachSubTree(root->right);
+    Node * middle;
+    int middleHeight;
+    Node * found;
+    int compare = compFunc(root->data, data);
+    if(compare == EQUALS)
+    {
+        *less = left;
+        *lessHeight = leftHeight;
+        *greater = right;
+        *greaterHeight = rightHeight;
+        root->left = root->right = root->parent = NULL;
+        return root;
+    }
+    if(compare > EQUALS)
+    {
+        found = splitAt(left, leftHeight, data, compFunc, less, lessHeight, &middle, &middleHeight);
+        *greater = joinWithPivot(middle, middleHeight, root, right, rightHeight, greaterHeight);
+    }
+    else
+    {
+        found = splitAt(right, rightHeight, data, compFunc, &middle, &middleHeight, greater, greaterHeight);
+        *less = joinWithPivot(left, leftHeight, root, middle, middleHeight, lessHeight);
+    }
+    return found;
+}
+
+/**
+ * counts the nodes of the smaller of two trees, by walking both in lockstep.
+ * @param less a tree
+ * @param greater another tree
+ * @param total the number of nodes in both trees
+ * @return the number of nodes in less, in O(min(|less|, |greater|))
+ */
+size_t sizeOfLess(Node * less, Node * greater, size_t total)
+{
+    Node * a = minNodeInSubTree(less);
+    Node * b = minNodeInSubTree(greater);
+    size_t steps = 0;
+    while(a != NULL && b != NULL)
+    {
+        a = findSuccessor(a);
+        b = findSuccessor(b);
+        ++steps;
+    }
+    return (a == NULL) ? steps : total - steps;
+}
+
+/**
+ * move all the items of tree2 to the end of tree1. all the items of tree1 must be lower than all the items of
+ * tree2. runs in O(log n). tree2 is freed.
+ * @param tree1: the tree to join into.
+ * @param tree2: the tree to join.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int joinRBTree(RBTree *tree1, RBTree *tree2)
+{
+    if(tree1 == NULL || tree2 == NULL || tree1 == tree2 || IS_MAP(tree1) != IS_MAP(tree2) || !promoteRBTree(tree1) ||
+       !promoteRBTree(tree2))
+    {
+        return 0;
+    }
+    Node * max = tree1->root;
+    while(max != NULL && max->right != NULL)
+    {
+        max = max->right;
+    }
+    Node * min = minNodeInSubTree(tree2->root);
+    if(max != NULL && min != NULL && tree1->compFunc(max->data, min->data) >= EQUALS)
+    {
+        return 0;
+    }
+    int height;
+    tree1->root = joinTwo(tree1->root, blackHeight(tree1->root), tree2->root, blackHeight(tree2->root), &height);
+    tree1->size += tree2->size;
+    freeCache(tree2);
+    free(tree2);
+    return 1;
+}
+
+/**
+ * split a tree into the items lower than data and the items greater or equal to data. the split itself runs
+ * in O(log n), but counting the new sizes walks the smaller part, so the whole call is
+ * O(log n + min(|less|, |greater|)): O(n) in the worst case. the tree is freed.
+ * @param tree: the tree to split.
+ * @param data: the item to split by, it does not have to be in the tree.
+ * @param less: out parameter for the tree of the lower items.
+ * @param greater: out parameter for the tree of the greater or equal items.
+ * @return: 0 on failure (then the tree is left untouched), other on success.
+ */
+int splitRBTree(RBTree *tree, void *data, RBTree **less, RBTree **greater)
+{
+    if(tree == NULL || data == NULL || less == NULL || greater == NULL || !promoteRBTree(tree))
+    {
+        return 0;
+    }
+    *less = newRBTree(tree->compFunc, tree->freeFunc);
+    *greater = newRBTree(tree->compFunc, tree->freeFunc);
+    if(*less == NULL || *greater == NULL)
+    {
+        free(*less);
+        free(*greater);
+        *less = *greater = NULL;
+        return 0;
+    }
+    (*less)->valueFreeFunc = (*greater)->valueFreeFunc = tree->valueFreeFunc;
+    (*less)->flatLimit = (*greater)->flatLimit = tree->flatLimit;
+    Node * lower;
+    Node * higher;
+    int lowerHeight;
+    int higherHeight;
+    Node * found = splitAt(tree->root, blackHeight(tree->root), data, tree->compFunc, &lower, &lowerHeight, &higher,
+                           &higherHeight);
+    if(found != NULL)
+    {
+        higher = joinWithPivot(NULL, 0, found, higher, higherHeight, &higherHeight);
+    }
+    (*less)->root = lower;
+    (*greater)->root = higher;
+    (*less)->size = sizeOfLess(lower, higher, tree->size);
+    (*greater)->size = tree->size - (*less)->size;
+    freeCache(tree);
+    free(tree);
+    return 1;
+}
+
+/**
+ * the union of two subtrees: splits a by the root of b and recurses on both sides.
+ * @param removed counts the items of b that were freed as duplicates
+ * @param height out parameter for the black height of the union
+ */
+Node * unionNodes(Node * a, int aHeight, Node * b, int bHeight, RBTree * treeB, size_t * removed, int * height)
+{
+    if(a == NULL)
+    {
+        *height = bHeight;
+        return detachSubTree(b);
+    }
+    if(b == NULL)
+    {
+        *height = aHeight;
+        return detachSubTree(a);
+    }
+    int bLeftHeight = childHeight(b, bHeight, b->left);
+    int bRightHeight = childHeight(b, bHeight, b->right);
+    Node * bLeft = detachSubTree(b->left);
+    Node * bRight = detachSubTree(b->right);
+    Node * less;
+    Node * greater;
+    int lessHeight;
+    int greaterHeight;
+    Node * pivot = splitAt(a, aHeight, b->data, treeB->compFunc, &less, &lessHeight, &greater, &greaterHeight);
+    if(pivot != NULL) // the item of a stays, the one of b is a duplicate
+    {
+        pivot->count += b->count;
+        freeNode(treeB, b);
+        ++*removed;
+    }
+    else
+    {
+        pivot = b;
+    }
+    int leftHeight;
+    int rightHeight;
+    Node * left = unionNodes(less, lessHeight, bLeft, bLeftHeight, treeB, removed, &leftHeight);
+    Node * right = unionNodes(greater, greaterHeight, bRight, bRightHeight, treeB, removed, &rightHeight);
+    return joinWithPivot(left, leftHeight, pivot, right, rightHeight, height);
+}
+
+/**
+ * the intersection of two subtrees: splits a by the root of b and recurses on both sides.
+ * @param kept counts the items of a that stay
+ * @param height out parameter for the black height of the intersection
+ */
+Node * intersectNodes(Node * a, int aHeight, Node * b, int bHeight, RBTree * treeA, RBTree * treeB, size_t * kept,
+                      int * height)
+{
+    if(a == NULL || b == NULL)
+    {
+        freeNodesInDepth(treeA, a);
+        freeNodesInDepth(treeB, b);
+        *height = 0;
+        return NULL;
+    }
+    int bLeftHeight = childHeight(b, bHeight, b->left);
+    int bRightHeight = childHeight(b, bHeight, b->right);
+    Node * bLeft = detachSubTree(b->left);
+    Node * bRight = detachSubTree(b->right);
+    Node * less;
+    Node * greater;
+    int lessHeight;
+    int greaterHeight;
+    Node * pivot = splitAt(a, aHeight, b->data, treeA->compFunc, &less, &lessHeight, &greater, &greaterHeight);
+    freeNode(treeB, b);
+    int leftHeight;
+    int rightHeight;
+    Node * left = intersectNodes(less, lessHeight, bLeft, bLeftHeight, treeA, treeB, kept, &leftHeight);
+    Node * right = intersectNodes(greater, greaterHeight, bRight, bRightHeight, treeA, treeB, kept, &rightHeight);
+    if(pivot == NULL)
+    {
+        return joinTwo(left, leftHeight, right, rightHeight, height);
+    }
+    ++*kept;
+    return joinWithPivot(left, leftHeight, pivot, right, rightHeight, height);
+}
+
+/**
+ * the difference of two subtrees: splits a by the root of b and recurses on both sides.
+ * @param removed counts the items of a that were freed
+ * @param height out parameter for the black height of the difference
+ */
+Node * differenceNodes(Node * a, int aHeight, Node * b, int bHeight, RBTree * treeA, RBTree * treeB,
+                       size_t * removed, int * height)
+{
+    if(a == NULL || b == NULL)
+    {
+        freeNodesInDepth(treeB, b);
+        *height = aHeight;
+        return detachSubTree(a);
+    }
+    int bLeftHeight = childHeight(b, bHeight, b->left);
+    int bRightHeight = childHeight(b, bHeight, b->right);
+    Node * bLeft = detachSubTree(b->left);
+    Node * bRight = detachSubTree(b->right);
+    Node * less;
+    Node * greater;
+    int lessHeight;
+    int greaterHeight;
+    Node * found = splitAt(a, aHeight, b->data, treeA->compFunc, &less, &lessHeight, &greater, &greaterHeight);
+    freeNode(treeB, b);
+    if(found != NULL)
+    {
+        freeNode(treeA, found);
+        ++*removed;
+    }
+    int leftHeight;
+    int rightHeight;
+    Node * left = differenceNodes(less, lessHeight, bLeft, bLeftHeight, treeA, treeB, removed, &leftHeight);
+    Node * right = differenceNodes(greater, greaterHeight, bRight, bRightHeight, treeA, treeB, removed,
+                                   &rightHeight);
+    return joinTwo(left, leftHeight, right, rightHeight, height);
+}
+
+/**
+ * move all the items of tree2 into tree1. items of tree2 that are already in tree1 are freed, and their
+ * counts (see incrementRBTree) are added to the counts in tree1. runs in O(m log(n / m + 1)) where m is
+ * the size of the smaller tree. tree2 is freed.
+ * @param tree1: the tree to hold the union.
+ * @param tree2: the other tree.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int unionRBTree(RBTree *tree1, RBTree *tree2)
+{
+    if(tree1 == NULL || tree2 == NULL || tree1 == tree2 || IS_MAP(tree1) != IS_MAP(tree2) || !promoteRBTree(tree1) ||
+       !promoteRBTree(tree2))
+    {
+        return 0;
+    }
+    size_t removed = 0;
+    int height;
+    tree1->root = unionNodes(tree1->root, blackHeight(tree1->root), tree2->root, blackHeight(tree2->root), tree2,
+                             &removed, &height);
+    tree1->size += tree2->size - removed;
+    freeCache(tree2);
+    free(tree2);
+    return 1;
+}
+
+/**
+ * keep in tree1 only the items that are also in tree2. all the other items of both trees are freed. the
+ * kept items keep their counts in tree1. runs in O(m log(n / m + 1)) where m is the size of the smaller
+ * tree. tree2 is freed.
+ * @param tree1: the tree to hold the intersection.
+ * @param tree2: the other tree.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int intersectRBTree(RBTree *tree1, RBTree *tree2)
+{
+    if(tree1 == NULL || tree2 == NULL || tree1 == tree2 || IS_MAP(tree1) != IS_MAP(tree2) || !promoteRBTree(tree1) ||
+       !promoteRBTree(tree2))
+    {
+        return 0;
+    }
+    size_t kept = 0;
+    clearCache(tree1);
+    int height;
+    tree1->root = intersectNodes(tree1->root, blackHeight(tree1->root), tree2->root, blackHeight(tree2->root),
+                                 tree1, tree2, &kept, &height);
+    tree1->size = kept;
+    freeCache(tree2);
+    free(tree2);
+    return 1;
+}
+
+/**
+ * remove from tree1 the items that are in tree2, whatever their counts. the removed items and all the items
+ * of tree2 are freed. runs in O(m log(n / m + 1)) where m is the size of the smaller tree. tree2 is freed.
+ * @param tree1: the tree to hold the difference.
+ * @param tree2: the items to remove.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int differenceRBTree(RBTree *tree1, RBTree *tree2)
+{
+    if(tree1 == NULL || tree2 == NULL || tree1 == tree2 || IS_MAP(tree1) != IS_MAP(tree2) || !promoteRBTree(tree1) ||
+       !promoteRBTree(tree2))
+    {
+        return 0;
+    }
+    size_t removed = 0;
+    clearCache(tree1);
+    int height;
+    tree1->root = differenceNodes(tree1->root, blackHeight(tree1->root), tree2->root, blackHeight(tree2->root),
+                                  tree1, tree2, &removed, &height);
+    tree1->size -= removed;
+    freeCache(tree2);
+    free(tree2);
+    return 1;
+}
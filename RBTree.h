@@ -5,6 +5,8 @@
 #ifndef RBTREE_RBTREE_H
 #define RBTREE_RBTREE_H
 
+#include <stddef.h>
+
 // a color of a Node.
 typedef enum Color
 {
@@ -26,12 +28,51 @@ typedef int (*CompareFunc)(const void *a, const void *b);
  */
 typedef int (*forEachFunc)(const void *object, void *args);
 
+/**
+ * a function to apply on all tree items together with their counts.
+ * @object: a pointer to an item of the tree.
+ * @count: the number of times the item was added (see incrementRBTree).
+ * @args: pointer to other arguments for the function.
+ * @return: 0 on failure, other on success.
+ */
+typedef int (*forEachCountFunc)(const void *object, int count, void *args);
+
+/**
+ * a function to apply on all the keys of a map tree together with their values.
+ * @key: a pointer to a key of the tree.
+ * @value: the value of the key, may be changed in place.
+ * @args: pointer to other arguments for the function.
+ * @return: 0 on failure, other on success.
+ */
+typedef int (*forEachPairFunc)(const void *key, void *value, void *args);
+
 /**
  * a function to free a data item
  * @object: a pointer to an item of the tree.
  */
 typedef void (*FreeFunc)(void *data);
 
+/**
+ * a function to copy a data item
+ * @data: a pointer to an item of the tree.
+ * @return: a new item equal to data, NULL on failure.
+ */
+typedef void *(*CopyFunc)(const void *data);
+
+/**
+ * a function to hash the tree items, for the lookup cache (see setCacheRBTree).
+ * @data: a pointer to an item of the tree.
+ * @return: the hash of the item. equal items must have equal hashes.
+ */
+typedef unsigned long (*HashFunc)(const void *data);
+
+/**
+ * a function to measure the memory of a data item, for memoryUsageRBTree.
+ * @data: a pointer to an item of the tree.
+ * @return: the number of bytes the item owns.
+ */
+typedef size_t (*SizeFunc)(const void *data);
+
 /*
  * a node of the tree.
  */
@@ -39,27 +80,111 @@ typedef struct Node
 {
 	struct Node *parent, *left, *right;
 	Color color;
+	int count; // how many times data was added, 1 unless incrementRBTree is used
 	void *data;
 
 } Node;
 
 /**
- * represents the tree
+ * a node of a map tree (see newMapRBTree), the value of the item follows its node. only map trees allocate
+ * it, so the other trees don't pay for the value.
+ */
+typedef struct MapNode
+{
+	Node node; // first, so a MapNode * is also a Node *
+	void *value;
+} MapNode;
+
+/**
+ * a direct mapped cache from recently found items to their nodes, checked before a lookup descends the tree.
+ * the slot of an item is hash & mask, and it holds the last node found for any item of that slot.
+ */
+typedef struct LookupCache
+{
+	Node **slots;
+	HashFunc hashFunc;
+	unsigned long mask; // the number of slots minus 1, the number of slots is a power of 2
+	long hits;
+	long misses;
+} LookupCache;
+
+/**
+ * represents the tree. a small tree keeps its items in a sorted array (flat) instead of nodes, and moves to
+ * nodes once it grows past flatLimit. root is NULL as long as the tree is flat. a map tree holds a value
+ * for each item (its key), it always uses nodes and has a valueFreeFunc.
  */
 typedef struct RBTree
 {
 	Node *root;
 	CompareFunc compFunc;
 	FreeFunc freeFunc;
-	int size;
+	FreeFunc valueFreeFunc; // NULL unless the tree is a map
+	LookupCache *cache; // NULL unless setCacheRBTree was called
+	size_t size;
+	void **flat;
+	size_t flatCapacity;
+	size_t flatLimit;
 } RBTree;
 
+/**
+ * a read-only snapshot of a tree, stored as an implicit array in Eytzinger (BFS) order.
+ * items[1] is the root and the children of items[k] are items[2k] and items[2k + 1].
+ */
+typedef struct FrozenRBTree
+{
+	void **items;
+	int *counts; // the counts of the items in ascending order, NULL if every count is 1
+	CompareFunc compFunc;
+	FreeFunc freeFunc;
+	size_t size;
+} FrozenRBTree;
+
 /**
  * constructs a new RBTree with the given CompareFunc.
  * comp: a function to compare two variables.
  */
 RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc); // implement it in RBTree.c
 
+/**
+ * constructs a new map tree, that holds a value for each key. the keys are ordered and freed like the items
+ * of a plain tree, the values are freed with their own function.
+ * @param compFunc: a function to compare two keys.
+ * @param keyFreeFunc: a function to free a key.
+ * @param valueFreeFunc: a function to free a value, it is not called for NULL values.
+ * @return: a pointer to the new tree, NULL on failure.
+ */
+RBTree *newMapRBTree(CompareFunc compFunc, FreeFunc keyFreeFunc, FreeFunc valueFreeFunc);
+
+/**
+ * set the size up to which the tree keeps its items in a sorted array instead of nodes. a tree that already
+ * holds more items than the new limit moves to nodes right away.
+ * @param tree: the tree to configure.
+ * @param limit: the new limit, 0 to always use nodes.
+ * @return: 0 on failure, other on success. (a map tree only accepts 0 - failure otherwise).
+ */
+int setFlatLimitRBTree(RBTree *tree, size_t limit);
+
+/**
+ * put a small cache of recently found items in front of the single item lookups (containsRBTree, findRBTree,
+ * countRBTree, removeFromRBTree, getRBTree), so a hot item is found with one comparison instead of a full
+ * descent. only a tree that uses nodes caches, and the batch lookups skip the cache. calling it again replaces
+ * the cache and resets its statistics. a lookup on a cached tree writes to the cache and its statistics, so
+ * lookups that would only read a plain tree are not safe to run concurrently on a cached one.
+ * @param tree: the tree to configure.
+ * @param hashFunc: a function to hash the items, may be NULL when capacity is 0.
+ * @param capacity: the number of cached items, rounded up to a power of 2. 0 removes the cache.
+ * @return: 0 on failure (then the old cache is kept), other on success.
+ */
+int setCacheRBTree(RBTree *tree, HashFunc hashFunc, size_t capacity);
+
+/**
+ * @param tree: the tree with the cache.
+ * @param hits: out parameter for the number of lookups that were answered by the cache, may be NULL.
+ * @param misses: out parameter for the number of lookups that descended the tree, may be NULL.
+ * @return: 0 if the tree has no cache, other on success.
+ */
+int cacheStatsRBTree(RBTree *tree, long *hits, long *misses);
+
 /**
  * add an item to the tree
  * @param tree: the tree to add an item to.
@@ -68,6 +193,77 @@ RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc); // implement it in R
  */
 int addToRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
+/**
+ * add many items to the tree. the batch is fastest when the items are sorted in ascending order: a batch whose
+ * range holds few nodes of the tree (as when it is appended) is merged with that range and joined back in
+ * O(range + n + log size), a spread out one is inserted starting from the previous insertion point instead of
+ * the root.
+ * @param tree: the tree to add the items to.
+ * @param items: the items to add. on success, the items that were not added (already in the tree or in the
+ * batch) are moved to the start of the array, so the caller can free them.
+ * @param n: number of items.
+ * @param duplicates: out parameter for the number of items that were not added, may be NULL.
+ * @return: 0 on failure (then none of the items was added and the tree and the array are left untouched),
+ * other on success.
+ */
+int addBatchRBTree(RBTree *tree, void **items, size_t n, size_t *duplicates);
+
+/**
+ * add delta to the count of an item, the tree counts how many times each item was added. the tree takes
+ * ownership of data: it is either stored or freed with the tree's FreeFunc (when an equal item is already in
+ * the tree, or delta is not positive and the item is not in the tree). an item whose count drops to 0 or
+ * less is removed. runs in a single descent.
+ * @param tree: the tree to count in.
+ * @param data: the item to count.
+ * @param delta: the amount to add, may be negative.
+ * @return: the new count of the item, -1 on failure (then data still belongs to the caller).
+ */
+int incrementRBTree(RBTree *tree, void *data, int delta);
+
+/**
+ * set the value of a key in a map tree, in a single descent. the tree takes ownership of key and value: if
+ * the key is already in the tree, the given key is freed and the value replaces (and frees) the old one.
+ * @param tree: the map tree.
+ * @param key: the key.
+ * @param value: the new value of the key, may be NULL.
+ * @return: 0 on failure (then key and value still belong to the caller), other on success.
+ */
+int putRBTree(RBTree *tree, void *key, void *value);
+
+/**
+ * find the value of a key in a map tree. the value may be read or replaced in place through the returned
+ * pointer, a replaced value is not freed by the tree.
+ * @param tree: the map tree.
+ * @param key: the key to look for.
+ * @return: a pointer to the value of the key, NULL if the key is not in the tree.
+ */
+void **getRBTree(RBTree *tree, void *key);
+
+/**
+ * find the value of a key in a map tree, and add the key with a NULL value if it is not there, in a single
+ * descent. the tree takes ownership of key: it is either stored or freed (when an equal key is already in the
+ * tree). the caller sets the value of a new key through the returned pointer.
+ * @param tree: the map tree.
+ * @param key: the key.
+ * @return: a pointer to the value of the key, NULL on failure (then key still belongs to the caller).
+ */
+void **getOrInsertRBTree(RBTree *tree, void *key);
+
+/**
+ * @param tree: the tree to count in.
+ * @param data: item to check.
+ * @return: the number of times the item is in the tree, 0 if it is not.
+ */
+int countRBTree(RBTree *tree, void *data);
+
+/**
+ * remove an item from the tree. the stored item is freed with the tree's FreeFunc.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove.
+ * @return: 0 on failure, other on success. (if the item is not in the tree - failure).
+ */
+int removeFromRBTree(RBTree *tree, void *data);
+
 /**
  * check whether the tree contains this item.
  * @param tree: the tree to add an item to.
@@ -76,8 +272,37 @@ int addToRBTree(RBTree *tree, void *data); // implement it in RBTree.c
  */
 int containsRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
+/**
+ * find the item of the tree that is equal to data.
+ * @param tree: the tree to search in.
+ * @param data: item to look for.
+ * @return: the stored item, NULL if the item is not in the tree.
+ */
+void *findRBTree(RBTree *tree, void *data);
 
 
+/**
+ * check for many items at once whether the tree contains them. the lookups advance in lockstep, one level
+ * at a time, so the cache misses of different lookups overlap.
+ * @param tree: the tree to search in.
+ * @param keys: the items to check.
+ * @param n: number of items.
+ * @param results: out array of n cells, each is set to 0 if the matching item is not in the tree, other if it is.
+ * @return: 0 on failure, other on success.
+ */
+int containsBatchRBTree(RBTree *tree, void **keys, size_t n, int *results);
+
+/**
+ * same as containsBatchRBTree, for keys sorted in ascending order. each lookup continues from the path of the
+ * previous one instead of the root. unsorted keys give correct results, only slower.
+ * @param tree: the tree to search in.
+ * @param keys: the items to check.
+ * @param n: number of items.
+ * @param results: out array of n cells, each is set to 0 if the matching item is not in the tree, other if it is.
+ * @return: 0 on failure, other on success.
+ */
+int containsSortedBatchRBTree(RBTree *tree, void **keys, size_t n, int *results);
+
 /**
  * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
  * function returns 0, the process stops.
@@ -88,11 +313,145 @@ int containsRBTree(RBTree *tree, void *data); // implement it in RBTree.c
  */
 int forEachRBTree(RBTree *tree, forEachFunc func, void *args); // implement it in RBTree.c
 
+/**
+ * Activate a function on each item of the tree in the range [from, to), in ascending order. if one of the
+ * activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param from: the lowest item of the range (inclusive), NULL for no lower bound. it does not have to be in the tree.
+ * @param to: the end of the range (exclusive), NULL for no upper bound. it does not have to be in the tree.
+ * @param func: the function to activate on the items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRangeRBTree(RBTree *tree, void *from, void *to, forEachFunc func, void *args);
+
+/**
+ * same as forEachRBTree, and also passes the count of each item (see incrementRBTree).
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachCountRBTree(RBTree *tree, forEachCountFunc func, void *args);
+
+/**
+ * same as forEachRBTree for a map tree, and also passes the value of each key. the values may be changed in
+ * place.
+ * @param tree: the map tree.
+ * @param func: the function to activate on all the keys.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachPairRBTree(RBTree *tree, forEachPairFunc func, void *args);
+
+/**
+ * make a copy of the tree with the same shape, colors and counts, in O(n) and without comparing items. each
+ * item is copied with copyFunc, and the copy gets the same flat limit and lookup cache settings.
+ * @param tree: the tree to copy, it is not changed.
+ * @param copyFunc: a function to copy an item, the copies must compare like the originals.
+ * @return: a pointer to the new tree, NULL on failure (or for a map tree, that can not be copied).
+ */
+RBTree *cloneRBTree(RBTree *tree, CopyFunc copyFunc);
+
+/**
+ * @param tree: the tree to measure.
+ * @param itemSize: a function to measure the memory an item owns, may be NULL to count only the tree itself.
+ * @param valueSize: a function to measure the memory a value of a map tree owns, may be NULL.
+ * @return: the number of bytes used by the tree: its nodes or flat array, its lookup cache and the payloads
+ * that were measured.
+ */
+size_t memoryUsageRBTree(RBTree *tree, SizeFunc itemSize, SizeFunc valueSize);
+
 /**
  * free all memory of the data structure.
  * @param tree: the tree to free.
  */
 void freeRBTree(RBTree *tree); // implement it in RBTree.c
 
+/**
+ * move all the items of tree2 to the end of tree1. all the items of tree1 must be lower than all the items of
+ * tree2. runs in O(log n). tree2 is freed.
+ * @param tree1: the tree to join into.
+ * @param tree2: the tree to join.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int joinRBTree(RBTree *tree1, RBTree *tree2);
+
+/**
+ * split a tree into the items lower than data and the items greater or equal to data. the split itself runs
+ * in O(log n), but counting the new sizes walks the smaller part, so the whole call is
+ * O(log n + min(|less|, |greater|)): O(n) in the worst case. the tree is freed.
+ * @param tree: the tree to split.
+ * @param data: the item to split by, it does not have to be in the tree.
+ * @param less: out parameter for the tree of the lower items.
+ * @param greater: out parameter for the tree of the greater or equal items.
+ * @return: 0 on failure (then the tree is left untouched), other on success.
+ */
+int splitRBTree(RBTree *tree, void *data, RBTree **less, RBTree **greater);
+
+/**
+ * move all the items of tree2 into tree1. items of tree2 that are already in tree1 are freed, and their
+ * counts (see incrementRBTree) are added to the counts in tree1. runs in O(m log(n / m + 1)) where m is
+ * the size of the smaller tree. tree2 is freed.
+ * @param tree1: the tree to hold the union.
+ * @param tree2: the other tree.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int unionRBTree(RBTree *tree1, RBTree *tree2);
+
+/**
+ * keep in tree1 only the items that are also in tree2. all the other items of both trees are freed. the
+ * kept items keep their counts in tree1. runs in O(m log(n / m + 1)) where m is the size of the smaller
+ * tree. tree2 is freed.
+ * @param tree1: the tree to hold the intersection.
+ * @param tree2: the other tree.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int intersectRBTree(RBTree *tree1, RBTree *tree2);
+
+/**
+ * remove from tree1 the items that are in tree2, whatever their counts. the removed items and all the items
+ * of tree2 are freed. runs in O(m log(n / m + 1)) where m is the size of the smaller tree. tree2 is freed.
+ * @param tree1: the tree to hold the difference.
+ * @param tree2: the items to remove.
+ * @return: 0 on failure (then both trees are left untouched), other on success. (if only one of them is a map
+ * tree - failure).
+ */
+int differenceRBTree(RBTree *tree1, RBTree *tree2);
+
+/**
+ * convert a tree into a read-only array layout that is faster to search. the items move to the frozen
+ * tree and the given tree is freed (on failure the tree is left untouched). a map tree can not be frozen.
+ * the counts of the items are kept for thawRBTree.
+ * @param tree: the tree to freeze.
+ * @return: a pointer to the frozen tree, NULL on failure.
+ */
+FrozenRBTree *freezeRBTree(RBTree *tree);
+
+/**
+ * check whether the frozen tree contains this item.
+ * @param frozen: the frozen tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsFrozenRBTree(FrozenRBTree *frozen, void *data);
+
+/**
+ * convert a frozen tree back into a mutable tree in O(n). the items move to the new tree with their counts
+ * and the frozen tree is freed (on failure the frozen tree is left untouched).
+ * @param frozen: the frozen tree to thaw.
+ * @return: a pointer to the new tree, NULL on failure.
+ */
+RBTree *thawRBTree(FrozenRBTree *frozen);
+
+/**
+ * free all memory of the frozen tree, including its items.
+ * @param frozen: the frozen tree to free.
+ */
+void freeFrozenRBTree(FrozenRBTree *frozen);
+
 
 #endif //RBTREE_RBTREE_H
\ No newline at end of file
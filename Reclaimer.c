@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "Reclaimer.h"
+
+#define RECLAIM_SLICE 4096 // items the background thread frees between checks of the queue
+
+long reclaimTree(DeferredTree *deferred, long maxNodes);
+void *runReclaimer(void *reclaimer);
+
+
+/**
+ * constructs a new reclaimer.
+ * @param background: other to free the trees on a background thread, 0 to free them only in reclaimRBTrees.
+ * @return: a pointer to the new reclaimer, NULL on failure.
+ */
+RBTreeReclaimer *newRBTreeReclaimer(int background)
+{
+    RBTreeReclaimer * reclaimer = (RBTreeReclaimer *) malloc(sizeof(RBTreeReclaimer));
+    if(reclaimer == NULL)
+    {
+        return NULL;
+    }
+    reclaimer->head = reclaimer->tail = NULL;
+    reclaimer->pending = 0;
+    reclaimer->background = background;
+    reclaimer->stopping = 0;
+    if(pthread_mutex_init(&reclaimer->lock, NULL) != 0)
+    {
+        free(reclaimer);
+        return NULL;
+    }
+    if(pthread_cond_init(&reclaimer->work, NULL) != 0)
+    {
+        pthread_mutex_destroy(&reclaimer->lock);
+        free(reclaimer);
+        return NULL;
+    }
+    if(pthread_cond_init(&reclaimer->done, NULL) != 0)
+    {
+        pthread_cond_destroy(&reclaimer->work);
+        pthread_mutex_destroy(&reclaimer->lock);
+        free(reclaimer);
+        return NULL;
+    }
+    if(background && pthread_create(&reclaimer->thread, NULL, runReclaimer, reclaimer) != 0)
+    {
+        pthread_cond_destroy(&reclaimer->done);
+        pthread_cond_destroy(&reclaimer->work);
+        pthread_mutex_destroy(&reclaimer->lock);
+        free(reclaimer);
+        return NULL;
+    }
+    return reclaimer;
+}
+
+/**
+ * free all memory of the tree later, through the reclaimer. the tree is detached in O(1), so the caller is
+ * not blocked by the size of the tree. the tree must not be used after the call.
+ * @param reclaimer: the reclaimer to free the tree.
+ * @param tree: the tree to free.
+ * @return: 0 if the tree could not be queued (then it was freed right away), other on success.
+ */
+int freeRBTreeDeferred(RBTreeReclaimer *reclaimer, RBTree *tree)
+{
+    if(tree == NULL)
+    {
+        return 1;
+    }
+    DeferredTree * deferred = (reclaimer == NULL) ? NULL : (DeferredTree *) malloc(sizeof(DeferredTree));
+    if(deferred == NULL)
+    {
+        freeRBTree(tree);
+        return 0;
+    }
+    deferred->next = NULL;
+    deferred->node = tree->root;
+    deferred->flat = tree->flat;
+    deferred->flatSize = (tree->root == NULL) ? tree->size : 0;
+    deferred->freeFunc = tree->freeFunc;
+    deferred->valueFreeFunc = tree->valueFreeFunc;
+    setCacheRBTree(tree, NULL, 0);
+    free(tree);
+    pthread_mutex_lock(&reclaimer->lock);
+    if(reclaimer->tail == NULL)
+    {
+        reclaimer->head = deferred;
+    }
+    else
+    {
+        reclaimer->tail->next = deferred;
+    }
+    reclaimer->tail = deferred;
+    ++reclaimer->pending;
+    pthread_cond_signal(&reclaimer->work);
+    pthread_mutex_unlock(&reclaimer->lock);
+    return 1;
+}
+
+/**
+ * frees items of a deferred tree.
+ * @param deferred the tree, owned by the calling thread
+ * @param maxNodes the most items to free
+ * @return the number of items that were freed, less than maxNodes only if the tree is fully freed
+ */
+long reclaimTree(DeferredTree *deferred, long maxNodes)
+{
+    long freed = 0;
+    while(freed < maxNodes && deferred->flatSize > 0)
+    {
+        deferred->freeFunc(deferred->flat[--deferred->flatSize]);
+        ++freed;
+    }
+    Node * node = deferred->node;
+    while(freed < maxNodes && node != NULL)
+    {
+        if(node->left != NULL) // rotate right, so the left subtree moves up without being freed yet
+        {
+            Node * left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+            continue;
+        }
+        Node * next = node->right;
+        deferred->freeFunc(node->data);
+        if(deferred->valueFreeFunc != NULL && ((MapNode *) node)->value != NULL) // the nodes of a map tree
+        {
+            deferred->valueFreeFunc(((MapNode *) node)->value);
+        }
+        free(node);
+        node = next;
+        ++freed;
+    }
+    deferred->node = node;
+    return freed;
+}
+
+/**
+ * free some of the queued trees in the calling thread, the oldest ones first.
+ * @param reclaimer: the reclaimer.
+ * @param maxNodes: the most items to free in this call.
+ * @return: the number of items that were freed.
+ */
+long reclaimRBTrees(RBTreeReclaimer *reclaimer, long maxNodes)
+{
+    if(reclaimer == NULL)
+    {
+        return 0;
+    }
+    long freed = 0;
+    pthread_mutex_lock(&reclaimer->lock);
+    while(freed < maxNodes && reclaimer->head != NULL)
+    {
+        DeferredTree * deferred = reclaimer->head; // taken off the queue, so other threads skip it
+        reclaimer->head = deferred->next;
+        if(reclaimer->head == NULL)
+        {
+            reclaimer->tail = NULL;
+        }
+        pthread_mutex_unlock(&reclaimer->lock);
+        freed += reclaimTree(deferred, maxNodes - freed);
+        int finished = (deferred->node == NULL && deferred->flatSize == 0);
+        if(finished)
+        {
+            free(deferred->flat);
+            free(deferred);
+        }
+        pthread_mutex_lock(&reclaimer->lock);
+        if(!finished) // back to the front, it is still the oldest
+        {
+            deferred->next = reclaimer->head;
+            reclaimer->head = deferred;
+            if(reclaimer->tail == NULL)
+            {
+                reclaimer->tail = deferred;
+            }
+        }
+        else if(--reclaimer->pending == 0)
+        {
+            pthread_cond_broadcast(&reclaimer->done);
+        }
+    }
+    pthread_mutex_unlock(&reclaimer->lock);
+    return freed;
+}
+
+/**
+ * the body of the background thread: frees the queued trees in slices until the reclaimer stops.
+ */
+void *runReclaimer(void *reclaimer)
+{
+    RBTreeReclaimer * r = (RBTreeReclaimer *) reclaimer;
+    while(1)
+    {
+        pthread_mutex_lock(&r->lock);
+        while(r->head == NULL && !r->stopping)
+        {
+            pthread_cond_wait(&r->work, &r->lock);
+        }
+        int stop = (r->head == NULL);
+        pthread_mutex_unlock(&r->lock);
+        if(stop)
+        {
+            return NULL;
+        }
+        reclaimRBTrees(r, RECLAIM_SLICE);
+    }
+}
+
+/**
+ * wait until all the trees that were queued so far are fully freed. a reclaimer without a background thread
+ * frees them in the calling thread.
+ * @param reclaimer: the reclaimer.
+ */
+void flushRBTreeReclaimer(RBTreeReclaimer *reclaimer)
+{
+    if(reclaimer == NULL)
+    {
+        return;
+    }
+    if(!reclaimer->background)
+    {
+        reclaimRBTrees(reclaimer, LONG_MAX);
+    }
+    pthread_mutex_lock(&reclaimer->lock);
+    while(reclaimer->pending > 0) // trees still being freed by other threads
+    {
+        pthread_cond_wait(&reclaimer->done, &reclaimer->lock);
+    }
+    pthread_mutex_unlock(&reclaimer->lock);
+}
+
+/**
+ * free all the queued trees, stop the background thread and free the reclaimer.
+ * @param reclaimer: the reclaimer to free.
+ */
+void freeRBTreeReclaimer(RBTreeReclaimer *reclaimer)
+{
+    if(reclaimer == NULL)
+    {
+        return;
+    }
+    flushRBTreeReclaimer(reclaimer);
+    if(reclaimer->background)
+    {
+        pthread_mutex_lock(&reclaimer->lock);
+        reclaimer->stopping = 1;
+        pthread_cond_signal(&reclaimer->work);
+        pthread_mutex_unlock(&reclaimer->lock);
+        pthread_join(reclaimer->thread, NULL);
+    }
+    pthread_cond_destroy(&reclaimer->done);
+    pthread_cond_destroy(&reclaimer->work);
+    pthread_mutex_destroy(&reclaimer->lock);
+    free(reclaimer);
+}
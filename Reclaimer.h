@@ -0,0 +1,74 @@
+#ifndef RBTREE_RECLAIMER_H
+#define RBTREE_RECLAIMER_H
+
+#include <pthread.h>
+#include "RBTree.h"
+
+/**
+ * a tree that was handed to a reclaimer and is not fully freed yet. the nodes that are left hang from node,
+ * each step rotates a left child up or frees a node without a left child, so no stack is needed.
+ */
+typedef struct DeferredTree
+{
+	struct DeferredTree *next;
+	Node *node;
+	void **flat;
+	size_t flatSize; // the items of flat that are left are flat[0 .. flatSize)
+	FreeFunc freeFunc;
+	FreeFunc valueFreeFunc;
+} DeferredTree;
+
+/**
+ * frees trees away from the callers of freeRBTreeDeferred: either on its own background thread, or in bounded
+ * slices through reclaimRBTrees.
+ */
+typedef struct RBTreeReclaimer
+{
+	DeferredTree *head, *tail;
+	int pending; // trees handed over and not fully freed yet, including the ones being freed right now
+	int background;
+	int stopping;
+	pthread_mutex_t lock;
+	pthread_cond_t work; // signaled when a tree is queued or the reclaimer stops
+	pthread_cond_t done; // signaled when pending drops to 0
+	pthread_t thread;
+} RBTreeReclaimer;
+
+/**
+ * constructs a new reclaimer.
+ * @param background: other to free the trees on a background thread, 0 to free them only in reclaimRBTrees.
+ * @return: a pointer to the new reclaimer, NULL on failure.
+ */
+RBTreeReclaimer *newRBTreeReclaimer(int background);
+
+/**
+ * free all memory of the tree later, through the reclaimer. the tree is detached in O(1), so the caller is
+ * not blocked by the size of the tree. the tree must not be used after the call.
+ * @param reclaimer: the reclaimer to free the tree.
+ * @param tree: the tree to free.
+ * @return: 0 if the tree could not be queued (then it was freed right away), other on success.
+ */
+int freeRBTreeDeferred(RBTreeReclaimer *reclaimer, RBTree *tree);
+
+/**
+ * free some of the queued trees in the calling thread, the oldest ones first.
+ * @param reclaimer: the reclaimer.
+ * @param maxNodes: the most items to free in this call.
+ * @return: the number of items that were freed.
+ */
+long reclaimRBTrees(RBTreeReclaimer *reclaimer, long maxNodes);
+
+/**
+ * wait until all the trees that were queued so far are fully freed. a reclaimer without a background thread
+ * frees them in the calling thread.
+ * @param reclaimer: the reclaimer.
+ */
+void flushRBTreeReclaimer(RBTreeReclaimer *reclaimer);
+
+/**
+ * free all the queued trees, stop the background thread and free the reclaimer.
+ * @param reclaimer: the reclaimer to free.
+ */
+void freeRBTreeReclaimer(RBTreeReclaimer *reclaimer);
+
+#endif //RBTREE_RECLAIMER_H
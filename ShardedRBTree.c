@@ -0,0 +1,652 @@
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t is POSIX, strict C99 does not declare it
+#include <stdlib.h>
+#include "ShardedRBTree.h"
+
+#define MIN_SHARD_SIZE 1024 // no shard is split before it holds REBALANCE_FACTOR times this many items
+#define REBALANCE_FACTOR 2 // a shard this many times larger than the average is split
+#define SAMPLES_PER_SHARD 128 // random descents for each piece a tree is split into
+#define SAMPLE_SEED 2463534242UL
+#define EQUALS 0
+
+/**
+ * an item reached by a random descent, weighted by the inverse of the chance to reach it (see sampleItem).
+ */
+typedef struct Sample
+{
+	void *item;
+	double weight;
+} Sample;
+
+void lockLayout(ShardedRBTree *tree, int write);
+int shardOf(ShardedRBTree *tree, void *data);
+int needsRebalance(ShardedRBTree *tree, size_t shardSize);
+unsigned long nextRandom(unsigned long *state);
+Sample sampleItem(RBTree *tree, unsigned long *state);
+void sortSamples(Sample *samples, Sample *scratch, size_t n, CompareFunc compFunc);
+int pickSplitters(ShardedRBTree *tree, RBTree *source, int pieces, void **splitters, Sample *samples,
+                  Sample *scratch);
+int joinShards(ShardedRBTree *tree, int lo);
+int splitShard(ShardedRBTree *tree, int index);
+void rebalanceShard(ShardedRBTree *tree, void *data);
+void keepJoinedShards(ShardedRBTree *tree, RBTree *joined, int count, RBTree **spare);
+int rebalanceShards(ShardedRBTree *tree);
+
+
+/**
+ * constructs a new sharded tree. all the items go to the first shard until it is split.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param numShards: the number of key ranges.
+ * @return: a pointer to the new sharded tree, NULL on failure.
+ */
+ShardedRBTree *newShardedRBTree(CompareFunc compFunc, FreeFunc freeFunc, int numShards)
+{
+    if(compFunc == NULL || freeFunc == NULL || numShards <= 0)
+    {
+        return NULL;
+    }
+    ShardedRBTree * tree = (ShardedRBTree *) malloc(sizeof(ShardedRBTree));
+    if(tree == NULL)
+    {
+        return NULL;
+    }
+    tree->shards = (Shard *) calloc(numShards, sizeof(Shard));
+    tree->splitters = (void **) malloc(sizeof(void *) * numShards);
+    if(tree->shards == NULL || tree->splitters == NULL || pthread_rwlock_init(&tree->layout, NULL) != 0)
+    {
+        free(tree->shards);
+        free(tree->splitters);
+        free(tree);
+        return NULL;
+    }
+    if(pthread_mutex_init(&tree->gate, NULL) != 0)
+    {
+        pthread_rwlock_destroy(&tree->layout);
+        free(tree->shards);
+        free(tree->splitters);
+        free(tree);
+        return NULL;
+    }
+    tree->numShards = numShards;
+    tree->numSplitters = 0;
+    tree->compFunc = compFunc;
+    tree->freeFunc = freeFunc;
+    tree->shardLimit = REBALANCE_FACTOR * MIN_SHARD_SIZE;
+    tree->random = SAMPLE_SEED;
+    for(int i = 0; i < numShards; ++i)
+    {
+        tree->shards[i].tree = newRBTree(compFunc, freeFunc);
+        if(tree->shards[i].tree == NULL || pthread_mutex_init(&tree->shards[i].lock, NULL) != 0)
+        {
+            freeRBTree(tree->shards[i].tree);
+            tree->numShards = i; // free only what was initialized
+            freeShardedRBTree(tree);
+            return NULL;
+        }
+    }
+    return tree;
+}
+
+/**
+ * locks the layout of the sharded tree. a rwlock may let readers in while a writer waits, and the writers of
+ * the shards hold it for reading back to back, so a rebalance could wait for as long as they keep adding.
+ * the gate is held while waiting for the lock, so the readers that come after a rebalance wait behind it.
+ * @param tree the sharded tree
+ * @param write 1 to lock the layout for writing, 0 for reading
+ */
+void lockLayout(ShardedRBTree *tree, int write)
+{
+    pthread_mutex_lock(&tree->gate);
+    if(write)
+    {
+        pthread_rwlock_wrlock(&tree->layout);
+    }
+    else
+    {
+        pthread_rwlock_rdlock(&tree->layout);
+    }
+    pthread_mutex_unlock(&tree->gate);
+}
+
+/**
+ * finds the shard of an item by a binary search over the splitters.
+ * @param tree the sharded tree, its layout lock must be held
+ * @param data an item
+ * @return the index of the shard that holds (or should hold) the item
+ */
+int shardOf(ShardedRBTree *tree, void *data)
+{
+    int lo = 0;
+    int hi = tree->numSplitters;
+    while(lo < hi) // counts the splitters that are lower or equal to data
+    {
+        int mid = lo + (hi - lo) / 2;
+        if(tree->compFunc(tree->splitters[mid], data) <= EQUALS)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * decides by the size of one shard only, so an insert does not have to track the total size.
+ * @param tree the sharded tree, its layout lock must be held
+ * @param shardSize the size of the shard that just grew
+ * @return 1 if the shards should be rebalanced, 0 otherwise
+ */
+int needsRebalance(ShardedRBTree *tree, size_t shardSize)
+{
+    return tree->numShards > 1 && shardSize > tree->shardLimit;
+}
+
+/**
+ * add an item to the sharded tree, only the shard of the item is locked. may split the shard if it grew far
+ * beyond the average. safe to call from several threads.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToShardedRBTree(ShardedRBTree *tree, void *data)
+{
+    if(tree == NULL || data == NULL)
+    {
+        return 0;
+    }
+    lockLayout(tree, 0);
+    Shard * shard = &tree->shards[shardOf(tree, data)];
+    pthread_mutex_lock(&shard->lock);
+    int added = addToRBTree(shard->tree, data);
+    size_t shardSize = shard->tree->size;
+    pthread_mutex_unlock(&shard->lock);
+    int rebalance = added && needsRebalance(tree, shardSize);
+    pthread_rwlock_unlock(&tree->layout);
+    if(rebalance)
+    {
+        rebalanceShard(tree, data);
+    }
+    return added;
+}
+
+/**
+ * check whether the sharded tree contains this item. safe to call from several threads.
+ * @param tree: the tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsShardedRBTree(ShardedRBTree *tree, void *data)
+{
+    if(tree == NULL || data == NULL)
+    {
+        return 0;
+    }
+    lockLayout(tree, 0);
+    Shard * shard = &tree->shards[shardOf(tree, data)];
+    pthread_mutex_lock(&shard->lock);
+    int found = containsRBTree(shard->tree, data);
+    pthread_mutex_unlock(&shard->lock);
+    pthread_rwlock_unlock(&tree->layout);
+    return found;
+}
+
+/**
+ * Activate a function on each item of the tree, in ascending order across all the shards. if one of the
+ * activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachShardedRBTree(ShardedRBTree *tree, forEachFunc func, void *args)
+{
+    if(tree == NULL || func == NULL)
+    {
+        return 0;
+    }
+    int result = 1;
+    lockLayout(tree, 0);
+    for(int i = 0; i < tree->numShards && result; ++i) // the shards are ordered by their key ranges
+    {
+        Shard * shard = &tree->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        if(shard->tree->size > 0)
+        {
+            result = forEachRBTree(shard->tree, func, args);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    pthread_rwlock_unlock(&tree->layout);
+    return result;
+}
+
+/**
+ * count the items of the sharded tree, by locking the shards one after the other. safe to call from several
+ * threads, but the count may be stale by the time it returns.
+ * @param tree: the tree to count.
+ * @return: the number of items in the tree.
+ */
+size_t sizeShardedRBTree(ShardedRBTree *tree)
+{
+    if(tree == NULL)
+    {
+        return 0;
+    }
+    size_t size = 0;
+    lockLayout(tree, 0);
+    for(int i = 0; i < tree->numShards; ++i)
+    {
+        pthread_mutex_lock(&tree->shards[i].lock);
+        size += tree->shards[i].tree->size;
+        pthread_mutex_unlock(&tree->shards[i].lock);
+    }
+    pthread_rwlock_unlock(&tree->layout);
+    return size;
+}
+
+/**
+ * a xorshift generator, only the splits use it and they hold the layout lock for writing.
+ */
+unsigned long nextRandom(unsigned long *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * samples an item by a descent that turns left or right at random until it falls off the tree. every empty
+ * child lies between two neighbouring items, so weighting the item above it by 2^depth, the inverse of the
+ * chance to fall there, spreads the weight of the samples evenly over the items in order, however
+ * unbalanced the tree is.
+ * @param tree a tree with at least one item
+ * @param state the state of the generator
+ * @return the sampled item and its weight
+ */
+Sample sampleItem(RBTree *tree, unsigned long *state)
+{
+    Sample sample = {NULL, 1};
+    if(tree->root == NULL) // a flat tree, its items are in an array
+    {
+        sample.item = tree->flat[nextRandom(state) % tree->size];
+        return sample;
+    }
+    for(Node * current = tree->root; current != NULL;)
+    {
+        sample.item = current->data;
+        sample.weight *= 2;
+        current = (nextRandom(state) & 1) ? current->left : current->right;
+    }
+    return sample;
+}
+
+/**
+ * sorts the samples by their items, with a merge sort since qsort can't pass the comparator of the tree.
+ * @param scratch room for n samples
+ */
+void sortSamples(Sample *samples, Sample *scratch, size_t n, CompareFunc compFunc)
+{
+    if(n < 2)
+    {
+        return;
+    }
+    size_t half = n / 2;
+    sortSamples(samples, scratch, half, compFunc);
+    sortSamples(samples + half, scratch, n - half, compFunc);
+    size_t i = 0;
+    size_t j = half;
+    size_t k = 0;
+    while(i < half && j < n)
+    {
+        scratch[k++] = (compFunc(samples[j].item, samples[i].item) < EQUALS) ? samples[j++] : samples[i++];
+    }
+    while(i < half)
+    {
+        scratch[k++] = samples[i++];
+    }
+    while(j < n)
+    {
+        scratch[k++] = samples[j++];
+    }
+    for(k = 0; k < n; ++k)
+    {
+        samples[k] = scratch[k];
+    }
+}
+
+/**
+ * picks splitters at the weighted quantiles of a sample of the items, so the cost depends on the number of
+ * pieces and not on the size of the tree. each splitter is greater than a sampled item before it, so no
+ * piece is left empty.
+ * @param tree the sharded tree, its layout lock must be held for writing
+ * @param source the tree to split, with at least one item
+ * @param pieces the number of pieces to split it into
+ * @param splitters out array of pieces - 1 cells
+ * @param samples room for pieces * SAMPLES_PER_SHARD samples
+ * @param scratch room for as many samples, to sort them
+ * @return the number of splitters, fewer if the sample holds too few different items
+ */
+int pickSplitters(ShardedRBTree *tree, RBTree *source, int pieces, void **splitters, Sample *samples,
+                  Sample *scratch)
+{
+    size_t n = (size_t) pieces * SAMPLES_PER_SHARD;
+    double total = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        samples[i] = sampleItem(source, &tree->random);
+        total += samples[i].weight;
+    }
+    sortSamples(samples, scratch, n, tree->compFunc);
+    int picked = 0;
+    void * previous = samples[0].item;
+    double below = 0; // the weight of the samples before samples[i]
+    for(size_t i = 0; i < n && picked < pieces - 1; ++i)
+    {
+        if(below * pieces >= total * (picked + 1) && tree->compFunc(previous, samples[i].item) < EQUALS)
+        {
+            splitters[picked++] = previous = samples[i].item;
+        }
+        below += samples[i].weight;
+    }
+    return picked;
+}
+
+/**
+ * joins two neighbouring shards into the lower one in O(log n). the shards above them move down, so the last
+ * shard becomes empty.
+ * @param tree the sharded tree, its layout lock must be held for writing
+ * @param lo the lower shard, lower than numSplitters
+ * @return 0 on failure (then the layout is left as it was), other on success
+ */
+int joinShards(ShardedRBTree *tree, int lo)
+{
+    RBTree * empty = newRBTree(tree->compFunc, tree->freeFunc);
+    if(empty == NULL || !joinRBTree(tree->shards[lo].tree, tree->shards[lo + 1].tree))
+    {
+        freeRBTree(empty);
+        return 0;
+    }
+    for(int i = lo + 1; i < tree->numShards - 1; ++i)
+    {
+        tree->shards[i].tree = tree->shards[i + 1].tree;
+    }
+    tree->shards[tree->numShards - 1].tree = empty;
+    for(int i = lo; i < tree->numSplitters - 1; ++i)
+    {
+        tree->splitters[i] = tree->splitters[i + 1];
+    }
+    --tree->numSplitters;
+    return 1;
+}
+
+/**
+ * splits a shard in two at the median of a sample of its items. the shards above it move up into the first
+ * empty shard. the split walks the smaller half to count it (see splitRBTree), the rest of the shards are not
+ * touched.
+ * @param tree the sharded tree, its layout lock must be held for writing and it must have an empty shard
+ * @param index the shard to split
+ * @return 0 on failure (then the layout is left as it was), other on success
+ */
+int splitShard(ShardedRBTree *tree, int index)
+{
+    RBTree * shard = tree->shards[index].tree;
+    Sample samples[2 * SAMPLES_PER_SHARD]; // small enough for the stack, so a split needs no room on the heap
+    Sample scratch[2 * SAMPLES_PER_SHARD];
+    void * median;
+    RBTree * less;
+    RBTree * greater;
+    if(shard->size == 0 || pickSplitters(tree, shard, 2, &median, samples, scratch) != 1 ||
+       !splitRBTree(shard, median, &less, &greater))
+    {
+        return 0;
+    }
+    int last = tree->numSplitters + 1; // the first empty shard
+    RBTree * empty = tree->shards[last].tree;
+    for(int i = last; i > index + 1; --i)
+    {
+        tree->shards[i].tree = tree->shards[i - 1].tree;
+    }
+    for(int i = tree->numSplitters; i > index; --i)
+    {
+        tree->splitters[i] = tree->splitters[i - 1];
+    }
+    tree->shards[index].tree = less;
+    tree->shards[index + 1].tree = greater;
+    tree->splitters[index] = median;
+    ++tree->numSplitters;
+    freeRBTree(empty);
+    return 1;
+}
+
+/**
+ * splits the shard of an item that grew past the limit. when no shard is empty, the smallest pair of
+ * neighbouring shards that is still smaller than the shard is joined to make room, and failing that the shard
+ * is joined with a much smaller neighbour and split again. unlike rebalanceShards this walks at most half of
+ * two shards, so a writer that trips it stalls the others for O(n / numShards).
+ * @param tree the sharded tree
+ * @param data an item of the shard that grew
+ */
+void rebalanceShard(ShardedRBTree *tree, void *data)
+{
+    lockLayout(tree, 1);
+    int index = shardOf(tree, data);
+    size_t size = tree->shards[index].tree->size;
+    if(!needsRebalance(tree, size)) // another writer split it first
+    {
+        pthread_rwlock_unlock(&tree->layout);
+        return;
+    }
+    if(tree->numSplitters + 1 == tree->numShards)
+    {
+        int pair = -1;
+        size_t pairSize = size;
+        for(int i = 0; i + 1 < tree->numShards; ++i)
+        {
+            size_t joined = tree->shards[i].tree->size + tree->shards[i + 1].tree->size;
+            if(i != index && i + 1 != index && joined < pairSize)
+            {
+                pair = i;
+                pairSize = joined;
+            }
+        }
+        size_t lowerSize = (index > 0) ? tree->shards[index - 1].tree->size : size;
+        size_t upperSize = (index + 1 < tree->numShards) ? tree->shards[index + 1].tree->size : size;
+        int neighbour = (lowerSize < upperSize) ? index - 1 : index; // the lower shard of the pair
+        if(pair >= 0 && joinShards(tree, pair))
+        {
+            index -= (pair < index);
+        }
+        else if(((lowerSize < upperSize) ? lowerSize : upperSize) <= size / REBALANCE_FACTOR &&
+                joinShards(tree, neighbour))
+        {
+            index = neighbour;
+        }
+    }
+    int split = tree->numSplitters + 1 < tree->numShards && splitShard(tree, index);
+    size_t total = 0;
+    size_t largest = 0;
+    for(int i = 0; i < tree->numShards; ++i)
+    {
+        total += tree->shards[i].tree->size;
+        largest = (tree->shards[i].tree->size > largest) ? tree->shards[i].tree->size : largest;
+    }
+    size_t average = total / tree->numShards;
+    tree->shardLimit = REBALANCE_FACTOR * ((average > MIN_SHARD_SIZE) ? average : MIN_SHARD_SIZE);
+    if(!split && largest > tree->shardLimit)
+    {
+        tree->shardLimit = REBALANCE_FACTOR * largest; // nothing to gain for now, wait until it doubles
+    }
+    pthread_rwlock_unlock(&tree->layout);
+}
+
+/**
+ * puts back the layout after a join of the shards stopped half way: the first count shards were joined into
+ * one tree, which becomes the first shard, and the shards after them move down to follow it.
+ * @param tree the sharded tree, its layout lock must be held for writing
+ * @param joined the tree of the first count shards
+ * @param count the number of shards in joined
+ * @param spare an empty tree for each shard, the ones that are not needed to fill the freed shards are freed
+ */
+void keepJoinedShards(ShardedRBTree *tree, RBTree *joined, int count, RBTree **spare)
+{
+    int gone = count - 1;
+    tree->shards[0].tree = joined;
+    for(int i = 1; i < tree->numShards; ++i)
+    {
+        tree->shards[i].tree = (i + gone < tree->numShards) ? tree->shards[i + gone].tree : spare[i];
+    }
+    for(int i = 0; i < tree->numShards - gone; ++i)
+    {
+        freeRBTree(spare[i]);
+    }
+    int splitters = (tree->numSplitters > gone) ? tree->numSplitters - gone : 0;
+    for(int i = 0; i < splitters; ++i)
+    {
+        tree->splitters[i] = tree->splitters[i + gone];
+    }
+    tree->numSplitters = splitters;
+}
+
+/**
+ * joins all the shards into one tree, picks new splitters at the quantiles of a sample of it and splits it
+ * again.
+ * @param tree the sharded tree
+ * @return 0 on failure, other on success
+ */
+int rebalanceShards(ShardedRBTree *tree)
+{
+    lockLayout(tree, 1);
+    // a join moves a small shard out of its flat array, which allocates, so it is done for all of them here
+    // while a failure still leaves every shard as it was
+    for(int i = 0; i < tree->numShards; ++i)
+    {
+        RBTree * shard = tree->shards[i].tree;
+        size_t flatLimit = shard->flatLimit;
+        if(!setFlatLimitRBTree(shard, 0))
+        {
+            pthread_rwlock_unlock(&tree->layout);
+            return 0;
+        }
+        setFlatLimitRBTree(shard, flatLimit); // only keeps the limit for the trees the split makes
+    }
+    // the splits allocate new trees, so the empty shards are prepared first in case one of them fails
+    RBTree ** spare = (RBTree **) calloc(tree->numShards, sizeof(RBTree *));
+    if(spare == NULL)
+    {
+        pthread_rwlock_unlock(&tree->layout);
+        return 0;
+    }
+    for(int i = 0; i < tree->numShards; ++i)
+    {
+        if((spare[i] = newRBTree(tree->compFunc, tree->freeFunc)) == NULL)
+        {
+            for(int j = 0; j < i; ++j)
+            {
+                freeRBTree(spare[j]);
+            }
+            free(spare);
+            pthread_rwlock_unlock(&tree->layout);
+            return 0;
+        }
+    }
+    RBTree * rest = tree->shards[0].tree;
+    int joined = 1;
+    while(joined < tree->numShards && joinRBTree(rest, tree->shards[joined].tree))
+    {
+        ++joined;
+    }
+    if(joined < tree->numShards)
+    {
+        keepJoinedShards(tree, rest, joined, spare);
+        free(spare);
+        pthread_rwlock_unlock(&tree->layout);
+        return 0;
+    }
+    size_t size = rest->size;
+    Sample * samples = (Sample *) malloc(sizeof(Sample) * tree->numShards * SAMPLES_PER_SHARD);
+    Sample * scratch = (Sample *) malloc(sizeof(Sample) * tree->numShards * SAMPLES_PER_SHARD);
+    if(samples == NULL || scratch == NULL)
+    {
+        free(samples);
+        free(scratch);
+        keepJoinedShards(tree, rest, joined, spare);
+        free(spare);
+        pthread_rwlock_unlock(&tree->layout);
+        return 0;
+    }
+    int picked = (size > 0) ? pickSplitters(tree, rest, tree->numShards, tree->splitters, samples, scratch) : 0;
+    free(samples);
+    free(scratch);
+    int shard = 0;
+    for(; shard < picked; ++shard)
+    {
+        RBTree * less;
+        RBTree * greater;
+        if(!splitRBTree(rest, tree->splitters[shard], &less, &greater))
+        {
+            break;
+        }
+        tree->shards[shard].tree = less;
+        rest = greater;
+    }
+    tree->shards[shard].tree = rest;
+    tree->numSplitters = shard;
+    size_t average = size / tree->numShards;
+    tree->shardLimit = REBALANCE_FACTOR * ((average > MIN_SHARD_SIZE) ? average : MIN_SHARD_SIZE);
+    for(int i = 0; i < tree->numShards; ++i)
+    {
+        if(i > shard)
+        {
+            tree->shards[i].tree = spare[i];
+        }
+        else
+        {
+            freeRBTree(spare[i]);
+        }
+    }
+    free(spare);
+    pthread_rwlock_unlock(&tree->layout);
+    return 1;
+}
+
+/**
+ * choose new splitters at the quantiles of a sample of the items and move the items between the shards so
+ * they hold about the same number of items. blocks all the other operations while it runs, and counting the
+ * items of the new shards walks them, so it takes O(n).
+ * @param tree: the tree to rebalance.
+ * @return: 0 on failure, other on success.
+ */
+int rebalanceShardedRBTree(ShardedRBTree *tree)
+{
+    if(tree == NULL)
+    {
+        return 0;
+    }
+    return rebalanceShards(tree);
+}
+
+/**
+ * free all memory of the sharded tree.
+ * @param tree: the tree to free.
+ */
+void freeShardedRBTree(ShardedRBTree *tree)
+{
+    if(tree == NULL)
+    {
+        return;
+    }
+    for(int i = 0; i < tree->numShards; ++i)
+    {
+        freeRBTree(tree->shards[i].tree);
+        pthread_mutex_destroy(&tree->shards[i].lock);
+    }
+    pthread_rwlock_destroy(&tree->layout);
+    pthread_mutex_destroy(&tree->gate);
+    free(tree->shards);
+    free(tree->splitters);
+    free(tree);
+}
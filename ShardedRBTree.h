@@ -0,0 +1,94 @@
+#ifndef RBTREE_SHARDEDRBTREE_H
+#define RBTREE_SHARDEDRBTREE_H
+
+#include <pthread.h>
+#include "RBTree.h"
+
+/**
+ * one key range of a sharded tree, with its own lock.
+ */
+typedef struct Shard
+{
+	pthread_mutex_t lock;
+	RBTree *tree;
+} Shard;
+
+/**
+ * an ordered container that partitions the items into key ranges, each held by a separate RBTree, so writers
+ * of different ranges don't block each other. shard i + 1 holds the items greater or equal to splitters[i].
+ */
+typedef struct ShardedRBTree
+{
+	Shard *shards;
+	void **splitters; // items owned by the shards, numShards - 1 cells
+	int numShards;
+	int numSplitters; // the shards after numSplitters are empty until a shard is split
+	CompareFunc compFunc;
+	FreeFunc freeFunc;
+	pthread_rwlock_t layout; // held for reading by every operation, for writing by a rebalance
+	pthread_mutex_t gate; // taken to lock the layout, so new readers queue behind a waiting rebalance
+	size_t shardLimit; // a shard that grows past this is split, set by the last split
+	unsigned long random; // the state of the generator that samples the splitters
+} ShardedRBTree;
+
+/**
+ * constructs a new sharded tree. all the items go to the first shard until it is split.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param numShards: the number of key ranges.
+ * @return: a pointer to the new sharded tree, NULL on failure.
+ */
+ShardedRBTree *newShardedRBTree(CompareFunc compFunc, FreeFunc freeFunc, int numShards);
+
+/**
+ * add an item to the sharded tree, only the shard of the item is locked. may split the shard if it grew far
+ * beyond the average size of the shards at the last split, which blocks the other operations while it walks
+ * half of the shard. safe to call from several threads.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int addToShardedRBTree(ShardedRBTree *tree, void *data);
+
+/**
+ * check whether the sharded tree contains this item. safe to call from several threads.
+ * @param tree: the tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int containsShardedRBTree(ShardedRBTree *tree, void *data);
+
+/**
+ * Activate a function on each item of the tree, in ascending order across all the shards. if one of the
+ * activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachShardedRBTree(ShardedRBTree *tree, forEachFunc func, void *args);
+
+/**
+ * count the items of the sharded tree, by locking the shards one after the other. safe to call from several
+ * threads, but the count may be stale by the time it returns.
+ * @param tree: the tree to count.
+ * @return: the number of items in the tree.
+ */
+size_t sizeShardedRBTree(ShardedRBTree *tree);
+
+/**
+ * choose new splitters at the quantiles of a sample of the items and move the items between the shards so
+ * they hold about the same number of items. blocks all the other operations while it runs, and counting the
+ * items of the new shards walks them, so it takes O(n).
+ * @param tree: the tree to rebalance.
+ * @return: 0 on failure, other on success.
+ */
+int rebalanceShardedRBTree(ShardedRBTree *tree);
+
+/**
+ * free all memory of the sharded tree.
+ * @param tree: the tree to free.
+ */
+void freeShardedRBTree(ShardedRBTree *tree);
+
+#endif //RBTREE_SHARDEDRBTREE_H
@@ -10,9 +10,23 @@
 #define GRT 1 // a > b
 #define SML -1 // a < b
 #define ZERO 0
+#define BLOCK_ALIGNMENT 64 // blocks start on a cache line
+#define VECTOR_ALIGNMENT 32 // each Vector's coordinates start on an AVX register boundary
+#define DEFAULT_POOL_CAPACITY 65536 // coordinates per block
+#define VECTORS_PER_BLOCK 4096
 
-int compare(const double * v1, const double * v2, int len, int longer);
+/**
+ * a memory block of a PoolArena, its usable memory follows the header.
+ */
+typedef struct PoolBlock
+{
+	struct PoolBlock *next;
+} PoolBlock;
+
+int compare(const double * v1, const double * v2, size_t len, int longer);
 double normCaLc(Vector * v);
+void *arenaAlloc(PoolArena * arena, size_t bytes, size_t alignment);
+void freeArena(PoolArena * arena);
 
 
 /**
@@ -27,6 +41,21 @@ int stringCompare(const void *a, const void *b)
     return strcmp((char*) a, (char *) b);
 }
 
+/**
+ * HashFunc for strings (assumes strings end with "\0"), FNV-1a
+ * @param s - char* pointer
+ * @return the hash of the string, equal strings have equal hashes
+ */
+unsigned long stringHash(const void *s)
+{
+    unsigned long hash = 2166136261UL;
+    for(const unsigned char * c = (const unsigned char *) s; *c != '\0'; ++c)
+    {
+        hash = (hash ^ *c) * 16777619UL;
+    }
+    return hash;
+}
+
 
 /**
  * ForEach function that concatenates the given word to pConcatenated. pConcatenated is already allocated with
@@ -91,9 +120,9 @@ int vectorCompare1By1(const void *a, const void *b)
 }
 
 
-int compare(const double * v1, const double * v2, int len, int longer)
+int compare(const double * v1, const double * v2, size_t len, int longer)
 {
-    for(int i = 0; i < len; ++i)
+    for(size_t i = 0; i < len; ++i)
     {
         if(v1[i] == v2[i])
         {
@@ -179,7 +208,7 @@ int copyIfNormIsLarger(const void *pVector, void *pMaxVector)
 double normCaLc(Vector * v)
 {
     double norm = 0;
-    for (int i = 0; i < v->len; ++i)
+    for (size_t i = 0; i < v->len; ++i)
     {
         norm += (double) (v->vector[i]*v->vector[i]);
     }
@@ -210,4 +239,167 @@ Vector *findMaxNormVectorInTree(RBTree *tree)
     v = NULL;
     return v;
 
-}
\ No newline at end of file
+}
+
+/**
+ * ParseFunc (see Loader.h) for Vectors written as a line of comma separated numbers.
+ * @param record the line
+ * @param length the length of the line
+ * @param args not used
+ * @return a new Vector (free it with freeVector), NULL if the line is not valid
+ */
+void *parseVector(const char *record, int length, void *args)
+{
+    (void) args;
+    if(record == NULL || length == ZERO)
+    {
+        return NULL;
+    }
+    size_t len = 1;
+    for(int i = 0; i < length; ++i)
+    {
+        len += (record[i] == ',');
+    }
+    Vector * v = (Vector *) malloc(sizeof(Vector));
+    if(v == NULL)
+    {
+        return NULL;
+    }
+    v->len = len;
+    v->vector = (double *) malloc(sizeof(double) * len);
+    const char * p = record;
+    for(size_t i = 0; v->vector != NULL && i < len; ++i)
+    {
+        char * end;
+        v->vector[i] = strtod(p, &end);
+        if(end == p || (*end != ',' && *end != '\0' && *end != '\r'))
+        {
+            freeVector(v);
+            return NULL;
+        }
+        p = end + 1;
+    }
+    if(v->vector == NULL)
+    {
+        freeVector(v);
+        return NULL;
+    }
+    return v;
+}
+
+/**
+ * @param capacity the number of coordinates to reserve in each block, 0 for the default
+ * @return a pointer to a new empty pool, NULL on failure
+ */
+VectorPool *newVectorPool(size_t capacity)
+{
+    VectorPool * pool = (VectorPool *) calloc(1, sizeof(VectorPool));
+    if(pool == NULL)
+    {
+        return NULL;
+    }
+    pool->coordinates.blockSize = sizeof(double) * ((capacity > 0) ? capacity : DEFAULT_POOL_CAPACITY);
+    pool->vectors.blockSize = sizeof(Vector) * VECTORS_PER_BLOCK;
+    return pool;
+}
+
+/**
+ * bump allocation from an arena, opens a new block when the current one is full.
+ * @param arena the arena
+ * @param bytes the size to allocate
+ * @param alignment the alignment of the result, a power of 2 up to BLOCK_ALIGNMENT
+ * @return a pointer to the memory, NULL on failure
+ */
+void *arenaAlloc(PoolArena * arena, size_t bytes, size_t alignment)
+{
+    char * start = (char *) (((size_t) arena->cursor + alignment - 1) & ~(alignment - 1));
+    if(arena->cursor == NULL || start + bytes > arena->end)
+    {
+        size_t size = (bytes > arena->blockSize) ? bytes : arena->blockSize;
+        PoolBlock * block = (PoolBlock *) malloc(sizeof(PoolBlock) + BLOCK_ALIGNMENT + size);
+        if(block == NULL)
+        {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        start = (char *) (((size_t) (block + 1) + BLOCK_ALIGNMENT - 1) & ~((size_t) BLOCK_ALIGNMENT - 1));
+        arena->end = start + size;
+    }
+    arena->cursor = start + bytes;
+    return start;
+}
+
+/**
+ * allocates a Vector from the pool.
+ * @param pool the pool to allocate from
+ * @param len the length of the Vector
+ * @param coordinates the values to copy into the Vector, may be NULL for a zero Vector
+ * @return a pointer to the Vector, NULL on failure
+ */
+Vector *newPooledVector(VectorPool *pool, size_t len, const double *coordinates)
+{
+    if(pool == NULL)
+    {
+        return NULL;
+    }
+    Vector * v = (Vector *) arenaAlloc(&pool->vectors, sizeof(Vector), sizeof(void *));
+    if(v == NULL)
+    {
+        return NULL;
+    }
+    v->vector = (double *) arenaAlloc(&pool->coordinates, sizeof(double) * len, VECTOR_ALIGNMENT);
+    if(v->vector == NULL)
+    {
+        return NULL;
+    }
+    v->len = len;
+    if(coordinates != NULL)
+    {
+        memcpy(v->vector, coordinates, sizeof(double) * len);
+    }
+    else
+    {
+        memset(v->vector, 0, sizeof(double) * len);
+    }
+    return v;
+}
+
+/**
+ * FreeFunc for Vectors of a pool. does nothing, the memory is released by freeVectorPool.
+ */
+void freePooledVector(void *pVector)
+{
+    (void) pVector;
+}
+
+/**
+ * frees all the blocks of an arena.
+ */
+void freeArena(PoolArena * arena)
+{
+    PoolBlock * block = arena->blocks;
+    while(block != NULL)
+    {
+        PoolBlock * next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->cursor = arena->end = NULL;
+}
+
+/**
+ * free all the Vectors of the pool at once. call it after freeing the tree that holds them.
+ * @param pool the pool to free
+ */
+void freeVectorPool(VectorPool *pool)
+{
+    if(pool == NULL)
+    {
+        return;
+    }
+    freeArena(&pool->coordinates);
+    freeArena(&pool->vectors);
+    free(pool);
+}
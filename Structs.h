@@ -2,6 +2,7 @@
 // Created by evyat on 10/13/2019.
 //
 
+#include <stddef.h>
 #include "RBTree.h"
 
 #ifndef TA_EX3_STRUCTS_H
@@ -12,7 +13,7 @@
  */
 typedef struct Vector
 {
-	int len;
+	size_t len;
 	double *vector;
 } Vector;
 
@@ -26,6 +27,13 @@ typedef struct Vector
  */
 int stringCompare(const void *a, const void *b); // implement it in Structs.c
 
+/**
+ * HashFunc for strings (assumes strings end with "\0")
+ * @param s - char* pointer
+ * @return the hash of the string, equal strings have equal hashes
+ */
+unsigned long stringHash(const void *s);
+
 /**
  * ForEach function that concatenates the given word to pConcatenated. pConcatenated is already allocated with
  * enough space.
@@ -71,4 +79,62 @@ int copyIfNormIsLarger(const void *pVector, void *pMaxVector); // implement it i
 Vector *findMaxNormVectorInTree(RBTree *tree); // implement it in Structs.c You must use copyIfNormIsLarger in the implementation!
 
 
+/**
+ * ParseFunc (see Loader.h) for Vectors written as a line of comma separated numbers.
+ * @param record the line
+ * @param length the length of the line
+ * @param args not used
+ * @return a new Vector (free it with freeVector), NULL if the line is not valid
+ */
+void *parseVector(const char *record, int length, void *args);
+
+/**
+ * a list of aligned memory blocks that are handed out by bumping a cursor and freed all at once.
+ */
+typedef struct PoolArena
+{
+	struct PoolBlock *blocks;
+	char *cursor;
+	char *end;
+	size_t blockSize;
+} PoolArena;
+
+/**
+ * allocates Vectors in bulk: the coordinates of all the Vectors are packed into large blocks, each Vector's
+ * coordinates start on a 32 bytes boundary, and the Vector structs come from blocks of their own. the
+ * Vectors stay valid until freeVectorPool.
+ */
+typedef struct VectorPool
+{
+	PoolArena coordinates;
+	PoolArena vectors;
+} VectorPool;
+
+/**
+ * @param capacity the number of coordinates to reserve in each block, 0 for the default
+ * @return a pointer to a new empty pool, NULL on failure
+ */
+VectorPool *newVectorPool(size_t capacity);
+
+/**
+ * allocates a Vector from the pool.
+ * @param pool the pool to allocate from
+ * @param len the length of the Vector
+ * @param coordinates the values to copy into the Vector, may be NULL for a zero Vector
+ * @return a pointer to the Vector, NULL on failure
+ */
+Vector *newPooledVector(VectorPool *pool, size_t len, const double *coordinates);
+
+/**
+ * FreeFunc for Vectors of a pool. does nothing, the memory is released by freeVectorPool.
+ */
+void freePooledVector(void *pVector);
+
+/**
+ * free all the Vectors of the pool at once. call it after freeing the tree that holds them.
+ * @param pool the pool to free
+ */
+void freeVectorPool(VectorPool *pool);
+
+
 #endif //TA_EX3_STRUCTS_H
@@ -0,0 +1,403 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "VectorIndex.h"
+
+#define LANES 4 // independent sums in the distance kernel, so the compiler can vectorize it
+
+/**
+ * the state of a walk that collects the Vectors of a tree.
+ */
+typedef struct VectorCollector
+{
+	Vector **items;
+	size_t count;
+	size_t dim;
+} VectorCollector;
+
+/**
+ * the k best candidates of a k-NN search, kept as a max heap by distance.
+ */
+typedef struct NeighborHeap
+{
+	size_t *indices;
+	double *distances;
+	size_t count;
+	size_t capacity;
+} NeighborHeap;
+
+/**
+ * the state of a radius search.
+ */
+typedef struct RadiusSearch
+{
+	double radius; // squared
+	forEachFunc func;
+	void *args;
+} RadiusSearch;
+
+int collectVector(const void *object, void *args);
+void buildKdTree(VectorIndex *index, size_t lo, size_t hi);
+void selectByCoordinate(Vector **items, size_t lo, size_t hi, size_t nth, size_t dim);
+double squaredDistance(const double *restrict a, const double *restrict b, size_t dim);
+void siftDown(NeighborHeap *heap, size_t i, size_t index, double distance);
+void pushNeighbor(NeighborHeap *heap, size_t index, double distance);
+void searchNearest(VectorIndex *index, size_t lo, size_t hi, const double *query, NeighborHeap *heap);
+int searchRadius(VectorIndex *index, size_t lo, size_t hi, const double *query, RadiusSearch *search);
+
+
+/**
+ * forEachFunc that collects the Vectors of the first Vector's length.
+ */
+int collectVector(const void *object, void *args)
+{
+    VectorCollector * collector = (VectorCollector *) args;
+    Vector * v = (Vector *) object;
+    if(collector->dim == 0)
+    {
+        collector->dim = v->len;
+    }
+    if(v->len == collector->dim && v->len > 0)
+    {
+        collector->items[collector->count++] = v;
+    }
+    return 1;
+}
+
+/**
+ * builds a spatial index over the Vectors of a tree. all the Vectors must have the length of the first one,
+ * the others are left out. the index is a snapshot: rebuild it after the tree changes.
+ * @param tree a pointer to a tree of Vectors
+ * @return a pointer to the new index, NULL on failure.
+ */
+VectorIndex *newVectorIndex(RBTree *tree)
+{
+    if(tree == NULL)
+    {
+        return NULL;
+    }
+    VectorIndex * index = (VectorIndex *) calloc(1, sizeof(VectorIndex));
+    if(index == NULL)
+    {
+        return NULL;
+    }
+    index->items = (Vector **) malloc(sizeof(Vector *) * (tree->size + 1));
+    index->dims = (size_t *) malloc(sizeof(size_t) * (tree->size + 1));
+    if(index->items == NULL || index->dims == NULL)
+    {
+        freeVectorIndex(index);
+        return NULL;
+    }
+    VectorCollector collector = {index->items, 0, 0};
+    forEachRBTree(tree, collectVector, &collector);
+    index->size = collector.count;
+    index->dim = collector.dim;
+    index->points = (double *) malloc(sizeof(double) * (index->size * index->dim + 1));
+    if(index->points == NULL)
+    {
+        freeVectorIndex(index);
+        return NULL;
+    }
+    buildKdTree(index, 0, index->size);
+    for(size_t i = 0; i < index->size; ++i)
+    {
+        memcpy(index->points + i * index->dim, index->items[i]->vector, sizeof(double) * index->dim);
+    }
+    return index;
+}
+
+/**
+ * places the median of the range at its middle, split by the coordinate of the widest spread.
+ */
+void buildKdTree(VectorIndex *index, size_t lo, size_t hi)
+{
+    if(lo >= hi)
+    {
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    size_t splitDim = 0;
+    double widest = -1;
+    for(size_t d = 0; d < index->dim; ++d)
+    {
+        double min = index->items[lo]->vector[d];
+        double max = min;
+        for(size_t i = lo + 1; i < hi; ++i)
+        {
+            double x = index->items[i]->vector[d];
+            min = (x < min) ? x : min;
+            max = (x > max) ? x : max;
+        }
+        if(max - min > widest)
+        {
+            widest = max - min;
+            splitDim = d;
+        }
+    }
+    selectByCoordinate(index->items, lo, hi, mid, splitDim);
+    index->dims[mid] = splitDim;
+    buildKdTree(index, lo, mid);
+    buildKdTree(index, mid + 1, hi);
+}
+
+/**
+ * reorders the range so the nth Vector is in its sorted place by coordinate dim, with lower or equal ones
+ * before it and greater or equal ones after it (quickselect).
+ */
+void selectByCoordinate(Vector **items, size_t lo, size_t hi, size_t nth, size_t dim)
+{
+    --hi;
+    while(lo < hi)
+    {
+        double pivot = items[lo + (hi - lo) / 2]->vector[dim];
+        size_t i = lo;
+        size_t j = hi;
+        while(i <= j)
+        {
+            while(items[i]->vector[dim] < pivot)
+            {
+                ++i;
+            }
+            while(items[j]->vector[dim] > pivot)
+            {
+                --j;
+            }
+            if(i <= j)
+            {
+                Vector * tmp = items[i];
+                items[i++] = items[j];
+                items[j] = tmp;
+                if(j == lo) // items[lo] is the minimum, so only the range after it is left
+                {
+                    break;
+                }
+                --j;
+            }
+        }
+        if(nth <= j)
+        {
+            hi = j;
+        }
+        else if(nth >= i)
+        {
+            lo = i;
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * the squared L2 distance between two points.
+ */
+double squaredDistance(const double *restrict a, const double *restrict b, size_t dim)
+{
+    double sums[LANES] = {0};
+    size_t i = 0;
+    for(; i + LANES <= dim; i += LANES)
+    {
+        for(int lane = 0; lane < LANES; ++lane)
+        {
+            double diff = a[i + lane] - b[i + lane];
+            sums[lane] += diff * diff;
+        }
+    }
+    for(; i < dim; ++i)
+    {
+        double diff = a[i] - b[i];
+        sums[0] += diff * diff;
+    }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+/**
+ * places a candidate in the heap, starting from cell i and moving down while it is closer than a child.
+ */
+void siftDown(NeighborHeap *heap, size_t i, size_t index, double distance)
+{
+    while(2 * i + 1 < heap->count)
+    {
+        size_t child = 2 * i + 1;
+        if(child + 1 < heap->count && heap->distances[child + 1] > heap->distances[child])
+        {
+            ++child;
+        }
+        if(heap->distances[child] <= distance)
+        {
+            break;
+        }
+        heap->distances[i] = heap->distances[child];
+        heap->indices[i] = heap->indices[child];
+        i = child;
+    }
+    heap->distances[i] = distance;
+    heap->indices[i] = index;
+}
+
+/**
+ * adds a candidate to the heap, replacing the farthest one if the heap is full.
+ */
+void pushNeighbor(NeighborHeap *heap, size_t index, double distance)
+{
+    if(heap->count == heap->capacity)
+    {
+        if(distance < heap->distances[0])
+        {
+            siftDown(heap, 0, index, distance);
+        }
+        return;
+    }
+    size_t i = heap->count++;
+    while(i > 0 && heap->distances[(i - 1) / 2] < distance) // sift up
+    {
+        heap->distances[i] = heap->distances[(i - 1) / 2];
+        heap->indices[i] = heap->indices[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->distances[i] = distance;
+    heap->indices[i] = index;
+}
+
+/**
+ * k-NN descent: the side of the query first, the other side only if it may hold a closer point.
+ */
+void searchNearest(VectorIndex *index, size_t lo, size_t hi, const double *query, NeighborHeap *heap)
+{
+    if(lo >= hi)
+    {
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    const double * point = index->points + mid * index->dim;
+    pushNeighbor(heap, mid, squaredDistance(point, query, index->dim));
+    double diff = query[index->dims[mid]] - point[index->dims[mid]];
+    if(diff < 0)
+    {
+        searchNearest(index, lo, mid, query, heap);
+    }
+    else
+    {
+        searchNearest(index, mid + 1, hi, query, heap);
+    }
+    if(heap->count < heap->capacity || diff * diff < heap->distances[0])
+    {
+        if(diff < 0)
+        {
+            searchNearest(index, mid + 1, hi, query, heap);
+        }
+        else
+        {
+            searchNearest(index, lo, mid, query, heap);
+        }
+    }
+}
+
+/**
+ * finds the k Vectors closest to query.
+ * @param index the index to search in
+ * @param query a Vector of the index's length
+ * @param k number of neighbors to find
+ * @param neighbors out array of k cells for the closest Vectors, in ascending distance
+ * @param distances out array of k cells for their L2 distances from query, may be NULL
+ * @return the number of neighbors found (less than k if the index is smaller), -1 on failure.
+ */
+int knnVectorIndex(VectorIndex *index, const Vector *query, int k, Vector **neighbors, double *distances)
+{
+    if(index == NULL || query == NULL || neighbors == NULL || k < 0 || (index->size > 0 && query->len != index->dim))
+    {
+        return -1;
+    }
+    NeighborHeap heap = {(size_t *) malloc(sizeof(size_t) * (k + 1)), (double *) malloc(sizeof(double) * (k + 1)), 0,
+                         (size_t) k};
+    if(heap.indices == NULL || heap.distances == NULL)
+    {
+        free(heap.indices);
+        free(heap.distances);
+        return -1;
+    }
+    if(k > 0)
+    {
+        searchNearest(index, 0, index->size, query->vector, &heap);
+    }
+    int found = (int) heap.count; // at most k
+    while(heap.count > 0) // pops the farthest each time, so the results are filled from the end
+    {
+        size_t last = --heap.count;
+        neighbors[last] = index->items[heap.indices[0]];
+        if(distances != NULL)
+        {
+            distances[last] = sqrt(heap.distances[0]);
+        }
+        siftDown(&heap, 0, heap.indices[last], heap.distances[last]);
+    }
+    free(heap.indices);
+    free(heap.distances);
+    return found;
+}
+
+/**
+ * radius descent: visits a side only if the splitting plane is within the radius.
+ * @return 0 if the function asked to stop, 1 otherwise
+ */
+int searchRadius(VectorIndex *index, size_t lo, size_t hi, const double *query, RadiusSearch *search)
+{
+    if(lo >= hi)
+    {
+        return 1;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    const double * point = index->points + mid * index->dim;
+    if(squaredDistance(point, query, index->dim) <= search->radius && !search->func(index->items[mid], search->args))
+    {
+        return 0;
+    }
+    double diff = query[index->dims[mid]] - point[index->dims[mid]];
+    if((diff < 0 || diff * diff <= search->radius) && !searchRadius(index, lo, mid, query, search))
+    {
+        return 0;
+    }
+    if(diff >= 0 || diff * diff <= search->radius)
+    {
+        return searchRadius(index, mid + 1, hi, query, search);
+    }
+    return 1;
+}
+
+/**
+ * Activate a function on each Vector whose L2 distance from query is at most radius, in no particular order.
+ * if one of the activations of the function returns 0, the process stops.
+ * @param index the index to search in
+ * @param query a Vector of the index's length
+ * @param radius the maximal distance
+ * @param func the function to activate on the Vectors
+ * @param args more optional arguments to the function (may be null if the given function support it)
+ * @return 0 on failure, other on success.
+ */
+int radiusVectorIndex(VectorIndex *index, const Vector *query, double radius, forEachFunc func, void *args)
+{
+    if(index == NULL || query == NULL || func == NULL || radius < 0 ||
+       (index->size > 0 && query->len != index->dim))
+    {
+        return 0;
+    }
+    RadiusSearch search = {radius * radius, func, args};
+    return searchRadius(index, 0, index->size, query->vector, &search);
+}
+
+/**
+ * free all memory of the index. the Vectors are not freed.
+ * @param index the index to free
+ */
+void freeVectorIndex(VectorIndex *index)
+{
+    if(index == NULL)
+    {
+        return;
+    }
+    free(index->items);
+    free(index->points);
+    free(index->dims);
+    free(index);
+}
@@ -0,0 +1,59 @@
+#ifndef RBTREE_VECTORINDEX_H
+#define RBTREE_VECTORINDEX_H
+
+#include "RBTree.h"
+#include "Structs.h"
+
+/**
+ * a k-d tree over the Vectors of an RBTree, for searches by L2 distance. the tree is implicit: the node of the
+ * range [lo, hi) is at mid = (lo + hi) / 2, its children are the ranges [lo, mid) and (mid, hi), and the node
+ * splits them by coordinate dims[mid]. the coordinates are copied into one contiguous buffer, the Vectors
+ * themselves still belong to the RBTree.
+ */
+typedef struct VectorIndex
+{
+	Vector **items;
+	double *points; // the coordinates of items[i] are points[i * dim .. (i + 1) * dim)
+	size_t *dims;
+	size_t size;
+	size_t dim;
+} VectorIndex;
+
+/**
+ * builds a spatial index over the Vectors of a tree. all the Vectors must have the length of the first one,
+ * the others are left out. the index is a snapshot: rebuild it after the tree changes.
+ * @param tree a pointer to a tree of Vectors
+ * @return a pointer to the new index, NULL on failure.
+ */
+VectorIndex *newVectorIndex(RBTree *tree);
+
+/**
+ * finds the k Vectors closest to query.
+ * @param index the index to search in
+ * @param query a Vector of the index's length
+ * @param k number of neighbors to find
+ * @param neighbors out array of k cells for the closest Vectors, in ascending distance
+ * @param distances out array of k cells for their L2 distances from query, may be NULL
+ * @return the number of neighbors found (less than k if the index is smaller), -1 on failure.
+ */
+int knnVectorIndex(VectorIndex *index, const Vector *query, int k, Vector **neighbors, double *distances);
+
+/**
+ * Activate a function on each Vector whose L2 distance from query is at most radius, in no particular order.
+ * if one of the activations of the function returns 0, the process stops.
+ * @param index the index to search in
+ * @param query a Vector of the index's length
+ * @param radius the maximal distance
+ * @param func the function to activate on the Vectors
+ * @param args more optional arguments to the function (may be null if the given function support it)
+ * @return 0 on failure, other on success.
+ */
+int radiusVectorIndex(VectorIndex *index, const Vector *query, double radius, forEachFunc func, void *args);
+
+/**
+ * free all memory of the index. the Vectors are not freed.
+ * @param index the index to free
+ */
+void freeVectorIndex(VectorIndex *index);
+
+#endif //RBTREE_VECTORINDEX_H
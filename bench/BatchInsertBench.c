@@ -0,0 +1,145 @@
+/**
+ * compares addBatchRBTree against one addToRBTree per item, for sorted micro-batches added to a large tree.
+ * usage: batch_insert_bench [tree size] [batch size] [items to add]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+#include "RBTree.h"
+
+#define DEFAULT_TREE_SIZE 2000000
+#define DEFAULT_BATCH_SIZE 4096
+#define DEFAULT_ADDED 2000000
+#define SEED 88172645463325252UL
+
+/**
+ * the keys a scenario adds, in batch order. every batch is sorted.
+ */
+typedef enum Scenario
+{
+    APPEND, // every key is greater than all the keys of the tree, as in a time series
+    INTERLEAVED, // the keys of a batch are consecutive and fall between the keys of the tree
+    SCATTERED // the keys of a batch are spread over the whole tree
+} Scenario;
+
+static const char *scenarioNames[] = {"append", "interleaved", "scattered"};
+
+/**
+ * the tree holds the even keys 0, 2, .., 2 * (treeSize - 1).
+ */
+RBTree *buildTree(size_t treeSize)
+{
+    RBTree * tree = newRBTree(benchCompareLong, benchFreeLong);
+    void ** items = (void **) malloc(sizeof(void *) * treeSize);
+    if(tree == NULL || items == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < treeSize; ++i)
+    {
+        items[i] = benchLong(2 * (long) i);
+    }
+    if(!addBatchRBTree(tree, items, treeSize, NULL))
+    {
+        exit(EXIT_FAILURE);
+    }
+    free(items);
+    return tree;
+}
+
+/**
+ * @param added at most treeSize, rounded down to whole batches, so the added keys are all different
+ * @return the keys to add, each batch of batchSize keys is sorted
+ */
+long *makeKeys(Scenario scenario, size_t treeSize, size_t batchSize, size_t added)
+{
+    long * keys = (long *) malloc(sizeof(long) * added);
+    if(keys == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    size_t stripes = treeSize / batchSize; // a scattered batch takes one key from each stripe
+    for(size_t i = 0; i < added; ++i)
+    {
+        size_t batch = i / batchSize;
+        size_t offset = i % batchSize;
+        if(scenario == APPEND)
+        {
+            keys[i] = 2 * (long) (treeSize + i);
+        }
+        else if(scenario == INTERLEAVED)
+        {
+            keys[i] = 2 * (long) i + 1;
+        }
+        else
+        {
+            keys[i] = 2 * (long) (offset * stripes + batch) + 1;
+        }
+    }
+    return keys;
+}
+
+/**
+ * @return the seconds it took to add all the keys, one by one or in batches
+ */
+double addKeys(RBTree *tree, const long *keys, size_t batchSize, size_t added, int batched)
+{
+    void ** items = (void **) malloc(sizeof(void *) * added);
+    if(items == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < added; ++i)
+    {
+        items[i] = benchLong(keys[i]);
+    }
+    double start = benchSeconds();
+    for(size_t i = 0; i < added; i += batchSize)
+    {
+        size_t n = (added - i < batchSize) ? added - i : batchSize;
+        if(batched)
+        {
+            addBatchRBTree(tree, items + i, n, NULL);
+            continue;
+        }
+        for(size_t j = i; j < i + n; ++j)
+        {
+            addToRBTree(tree, items[j]);
+        }
+    }
+    double seconds = benchSeconds() - start;
+    free(items);
+    return seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t treeSize = benchArg(argc, argv, 1, DEFAULT_TREE_SIZE);
+    size_t batchSize = benchArg(argc, argv, 2, DEFAULT_BATCH_SIZE);
+    size_t added = benchArg(argc, argv, 3, DEFAULT_ADDED);
+    batchSize = (batchSize > treeSize) ? treeSize : batchSize;
+    added = (added > treeSize) ? treeSize : added;
+    added -= added % batchSize;
+    printf("tree of %zu items, %zu items added in batches of %zu\n", treeSize, added, batchSize);
+    printf("%-12s %12s %12s %9s\n", "scenario", "single (s)", "batch (s)", "speedup");
+    int failed = 0;
+    for(int scenario = APPEND; scenario <= SCATTERED; ++scenario)
+    {
+        long * keys = makeKeys((Scenario) scenario, treeSize, batchSize, added);
+        RBTree * single = buildTree(treeSize);
+        RBTree * batch = buildTree(treeSize);
+        double singleSeconds = addKeys(single, keys, batchSize, added, 0);
+        double batchSeconds = addKeys(batch, keys, batchSize, added, 1);
+        printf("%-12s %12.3f %12.3f %8.2fx\n", scenarioNames[scenario], singleSeconds, batchSeconds,
+               singleSeconds / batchSeconds);
+        if(single->size != treeSize + added || batch->size != single->size)
+        {
+            printf("  size mismatch: %zu one by one, %zu in batches\n", single->size, batch->size);
+            failed = 1;
+        }
+        freeRBTree(single);
+        freeRBTree(batch);
+        free(keys);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime is POSIX, strict C99 does not declare it
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Bench.h"
+
+double benchSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+int benchCompareLong(const void *a, const void *b)
+{
+    long x = *(const long *) a;
+    long y = *(const long *) b;
+    return (x > y) - (x < y);
+}
+
+void benchFreeLong(void *p)
+{
+    free(p);
+}
+
+long *benchLong(long value)
+{
+    long * item = (long *) malloc(sizeof(long));
+    if(item == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    *item = value;
+    return item;
+}
+
+size_t benchArg(int argc, char *argv[], int index, size_t fallback)
+{
+    if(index >= argc)
+    {
+        return fallback;
+    }
+    long value = strtol(argv[index], NULL, 10);
+    return (value > 0) ? (size_t) value : fallback;
+}
+
+unsigned long benchRandom(unsigned long *state)
+{
+    unsigned long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
@@ -0,0 +1,48 @@
+#ifndef RBTREE_BENCH_H
+#define RBTREE_BENCH_H
+
+#include <stddef.h>
+
+/**
+ * helpers shared by the benchmarks. the items of the benchmark trees are heap allocated longs.
+ */
+
+/**
+ * @return: a monotonic time in seconds, only the difference of two calls is meaningful.
+ */
+double benchSeconds(void);
+
+/**
+ * CompareFunc for longs.
+ */
+int benchCompareLong(const void *a, const void *b);
+
+/**
+ * FreeFunc for longs.
+ */
+void benchFreeLong(void *p);
+
+/**
+ * @param value: the value of the item.
+ * @return: a new heap allocated long, the benchmark exits if the allocation fails.
+ */
+long *benchLong(long value);
+
+/**
+ * reads a positive size argument.
+ * @param argc: the number of arguments.
+ * @param argv: the arguments.
+ * @param index: the index of the argument.
+ * @param fallback: the value to use if the argument is missing.
+ * @return: the argument, or fallback.
+ */
+size_t benchArg(int argc, char *argv[], int index, size_t fallback);
+
+/**
+ * a deterministic pseudo random generator (xorshift), so each run measures the same work.
+ * @param state: the state of the generator, not 0.
+ * @return: the next number.
+ */
+unsigned long benchRandom(unsigned long *state);
+
+#endif //RBTREE_BENCH_H
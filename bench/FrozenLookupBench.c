@@ -0,0 +1,139 @@
+/**
+ * compares the lookup latency of containsFrozenRBTree against containsRBTree on the same items, for trees
+ * from a few thousand items up to the given size. half of the looked up keys are in the tree.
+ * usage: frozen_lookup_bench [largest tree size] [lookups per tree]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+#include "RBTree.h"
+
+#define DEFAULT_TREE_SIZE 2000000
+#define DEFAULT_LOOKUPS 1000000
+#define SMALLEST_TREE 4096
+#define SIZE_STEP 8 // each tree is this many times larger than the previous one
+#define SEED 88172645463325252UL
+
+/**
+ * the tree holds the even keys 0, 2, .., 2 * (treeSize - 1), inserted one by one in a random order so the
+ * nodes are spread over the heap as in a tree that grew over time.
+ */
+RBTree *buildTree(const long *order, size_t treeSize)
+{
+    RBTree * tree = newRBTree(benchCompareLong, benchFreeLong);
+    if(tree == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < treeSize; ++i)
+    {
+        if(!addToRBTree(tree, benchLong(order[i])))
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+    return tree;
+}
+
+/**
+ * @return: the keys of the tree in a random order.
+ */
+long *shuffledKeys(size_t treeSize, unsigned long *state)
+{
+    long * keys = (long *) malloc(sizeof(long) * treeSize);
+    if(keys == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < treeSize; ++i)
+    {
+        keys[i] = 2 * (long) i;
+    }
+    for(size_t i = treeSize - 1; i > 0; --i)
+    {
+        size_t j = benchRandom(state) % (i + 1);
+        long swap = keys[i];
+        keys[i] = keys[j];
+        keys[j] = swap;
+    }
+    return keys;
+}
+
+/**
+ * @return: the tree size to measure after treeSize (0 for the first one), or 0 after the largest.
+ */
+size_t nextSize(size_t treeSize, size_t largest)
+{
+    if(treeSize == largest)
+    {
+        return 0;
+    }
+    if(treeSize == 0)
+    {
+        return (largest < SMALLEST_TREE) ? largest : SMALLEST_TREE;
+    }
+    return (treeSize * SIZE_STEP > largest) ? largest : treeSize * SIZE_STEP;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t largest = benchArg(argc, argv, 1, DEFAULT_TREE_SIZE);
+    size_t lookups = benchArg(argc, argv, 2, DEFAULT_LOOKUPS);
+    unsigned long state = SEED;
+    long * keys = (long *) malloc(sizeof(long) * lookups);
+    char * found = (char *) malloc(sizeof(char) * lookups);
+    if(keys == NULL || found == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("%zu random lookups per tree, half of them hits\n", lookups);
+    printf("%-12s %14s %14s %9s\n", "tree size", "tree (ns)", "frozen (ns)", "speedup");
+    int failed = 0;
+    for(size_t treeSize = nextSize(0, largest); treeSize != 0; treeSize = nextSize(treeSize, largest))
+    {
+        long * order = shuffledKeys(treeSize, &state);
+        RBTree * tree = buildTree(order, treeSize);
+        FrozenRBTree * frozen = freezeRBTree(buildTree(order, treeSize));
+        free(order);
+        if(frozen == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        for(size_t i = 0; i < lookups; ++i)
+        {
+            keys[i] = (long) (benchRandom(&state) % (2 * treeSize));
+        }
+        size_t treeHits = 0;
+        double start = benchSeconds();
+        for(size_t i = 0; i < lookups; ++i)
+        {
+            found[i] = (char) (containsRBTree(tree, &keys[i]) != 0);
+            treeHits += found[i];
+        }
+        double treeSeconds = benchSeconds() - start;
+        size_t mismatches = 0;
+        start = benchSeconds();
+        for(size_t i = 0; i < lookups; ++i)
+        {
+            mismatches += ((containsFrozenRBTree(frozen, &keys[i]) != 0) != found[i]);
+        }
+        double frozenSeconds = benchSeconds() - start;
+        printf("%-12zu %14.1f %14.1f %8.2fx\n", treeSize, treeSeconds * 1e9 / (double) lookups,
+               frozenSeconds * 1e9 / (double) lookups, treeSeconds / frozenSeconds);
+        size_t expectedHits = 0;
+        for(size_t i = 0; i < lookups; ++i)
+        {
+            expectedHits += (keys[i] % 2 == 0);
+        }
+        if(mismatches != 0 || treeHits != expectedHits)
+        {
+            printf("  wrong results: %zu lookups disagree, %zu hits of %zu\n", mismatches, treeHits, expectedHits);
+            failed = 1;
+        }
+        freeRBTree(tree);
+        freeFrozenRBTree(frozen);
+    }
+    free(keys);
+    free(found);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/**
+ * measures the records per second of loadRBTree on a generated CSV file of Vectors, against reading the file
+ * a line at a time with fgets and adding each Vector with addToRBTree. the lines are in a random order and the
+ * last one has no line break, every run checks that all of them were added.
+ * usage: loader_bench [records] [most threads]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Bench.h"
+#include "Loader.h"
+#include "RBTree.h"
+#include "Structs.h"
+
+#define DEFAULT_RECORDS 2000000
+#define DEFAULT_THREADS 8
+#define INPUT_FILE "loader_bench.csv"
+#define LINE_SIZE 128
+#define SEED 88172645463325252UL
+
+/**
+ * writes the records "i,x,y,z" for i = 0, 1, .., records - 1 in a random order, with random coordinates in
+ * [0, 1), so every line is a different Vector. the benchmark exits if the file can't be written.
+ * @param last: out buffer of LINE_SIZE chars for the last line.
+ */
+void writeInput(size_t records, char *last)
+{
+    long * order = (long *) malloc(sizeof(long) * records);
+    FILE * file = fopen(INPUT_FILE, "w");
+    if(order == NULL || file == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    unsigned long state = SEED;
+    for(size_t i = 0; i < records; ++i)
+    {
+        order[i] = (long) i;
+    }
+    for(size_t i = records - 1; i > 0; --i)
+    {
+        size_t j = benchRandom(&state) % (i + 1);
+        long swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+    for(size_t i = 0; i < records; ++i)
+    {
+        snprintf(last, LINE_SIZE, "%ld,%.6f,%.6f,%.6f", order[i], (double) (benchRandom(&state) % 1000000) / 1e6,
+                 (double) (benchRandom(&state) % 1000000) / 1e6, (double) (benchRandom(&state) % 1000000) / 1e6);
+        fprintf(file, (i + 1 < records) ? "%s\n" : "%s", last);
+    }
+    free(order);
+    if(fclose(file) != 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * adds the lines of the input one at a time.
+ * @return: the number of Vectors added, -1 on failure.
+ */
+long loadByLine(RBTree *tree)
+{
+    FILE * file = fopen(INPUT_FILE, "r");
+    if(file == NULL)
+    {
+        return -1;
+    }
+    char line[LINE_SIZE];
+    long added = 0;
+    while(fgets(line, LINE_SIZE, file) != NULL)
+    {
+        int length = (int) strcspn(line, "\n");
+        line[length] = '\0';
+        Vector * vector = (Vector *) parseVector(line, length, NULL);
+        if(vector != NULL && addToRBTree(tree, vector))
+        {
+            ++added;
+        }
+        else
+        {
+            freeVector(vector);
+        }
+    }
+    fclose(file);
+    return added;
+}
+
+/**
+ * prints a row and checks that every record, the last one too, is in the tree.
+ * @return: 1 if the tree holds all the records, 0 otherwise.
+ */
+int report(const char *name, int threads, RBTree *tree, long added, size_t records, double seconds,
+           double baseline, Vector *last)
+{
+    printf("%-10s %7d %14.2f %9.2fx\n", name, threads, (double) records / seconds / 1e6, baseline / seconds);
+    if(added < 0 || (size_t) added != records || tree->size != records || !containsRBTree(tree, last))
+    {
+        printf("  wrong results: %ld added, %zu in the tree of %zu records\n", added, tree->size, records);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t records = benchArg(argc, argv, 1, DEFAULT_RECORDS);
+    int most = (int) benchArg(argc, argv, 2, DEFAULT_THREADS);
+    char lastLine[LINE_SIZE];
+    writeInput(records, lastLine);
+    Vector * last = (Vector *) parseVector(lastLine, (int) strlen(lastLine), NULL);
+    if(last == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("%zu records of 4 coordinates\n", records);
+    printf("%-10s %7s %14s %10s\n", "loader", "threads", "Mrecords/s", "speedup");
+    RBTree * tree = newRBTree(vectorCompare1By1, freeVector);
+    if(tree == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    double start = benchSeconds();
+    long added = loadByLine(tree);
+    double baseline = benchSeconds() - start;
+    int passed = report("by line", 1, tree, added, records, baseline, baseline, last);
+    freeRBTree(tree);
+    for(int threads = 1; threads <= most; threads *= 2)
+    {
+        tree = newRBTree(vectorCompare1By1, freeVector);
+        if(tree == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        start = benchSeconds();
+        added = loadRBTree(tree, INPUT_FILE, 0, parseVector, NULL, threads);
+        passed &= report("loadRBTree", threads, tree, added, records, benchSeconds() - start, baseline, last);
+        freeRBTree(tree);
+    }
+    freeVector(last);
+    remove(INPUT_FILE);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
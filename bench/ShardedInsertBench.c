@@ -0,0 +1,207 @@
+/**
+ * measures how inserts scale with the number of writer threads, for a ShardedRBTree against one RBTree behind
+ * a mutex. the longest single insert shows how long a split of a shard stalls the writers.
+ * usage: sharded_insert_bench [items] [most threads] [shards]
+ */
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t is POSIX, strict C99 does not declare it
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "Bench.h"
+#include "ShardedRBTree.h"
+
+#define DEFAULT_ITEMS 2000000
+#define DEFAULT_THREADS 8
+#define DEFAULT_SHARDS 16
+#define SEED 88172645463325252UL
+
+/**
+ * the keys the threads add, all of them different.
+ */
+typedef enum Scenario
+{
+    RANDOM, // spread over the whole key range
+    ASCENDING // every thread adds increasing keys, so the inserts drift to the top of the range
+} Scenario;
+
+static const char *scenarioNames[] = {"random", "ascending"};
+
+/**
+ * one RBTree that every writer locks.
+ */
+typedef struct LockedTree
+{
+    pthread_mutex_t lock;
+    RBTree *tree;
+} LockedTree;
+
+/**
+ * the work of one writer thread.
+ */
+typedef struct Writer
+{
+    LockedTree *locked; // NULL to add to sharded
+    ShardedRBTree *sharded;
+    void **items;
+    size_t n;
+    double longest; // out, the seconds of the slowest insert
+    size_t failed; // out, the inserts that returned 0
+} Writer;
+
+/**
+ * the thread function, adds the items of one writer.
+ */
+void *writeItems(void *args)
+{
+    Writer * writer = (Writer *) args;
+    for(size_t i = 0; i < writer->n; ++i)
+    {
+        double start = benchSeconds();
+        int added;
+        if(writer->locked != NULL)
+        {
+            pthread_mutex_lock(&writer->locked->lock);
+            added = addToRBTree(writer->locked->tree, writer->items[i]);
+            pthread_mutex_unlock(&writer->locked->lock);
+        }
+        else
+        {
+            added = addToShardedRBTree(writer->sharded, writer->items[i]);
+        }
+        double seconds = benchSeconds() - start;
+        writer->longest = (seconds > writer->longest) ? seconds : writer->longest;
+        writer->failed += !added;
+    }
+    return NULL;
+}
+
+/**
+ * @return: the keys 0, 1, .., items - 1, in a random order or ascending.
+ */
+long *makeKeys(Scenario scenario, size_t items)
+{
+    long * keys = (long *) malloc(sizeof(long) * items);
+    if(keys == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < items; ++i)
+    {
+        keys[i] = (long) i;
+    }
+    unsigned long state = SEED;
+    for(size_t i = items - 1; scenario == RANDOM && i > 0; --i)
+    {
+        size_t j = benchRandom(&state) % (i + 1);
+        long swap = keys[i];
+        keys[i] = keys[j];
+        keys[j] = swap;
+    }
+    return keys;
+}
+
+/**
+ * adds all the keys with the given number of writer threads, to locked or to sharded. writer t adds the keys
+ * t, t + threads, t + 2 * threads, .. of the array, so ascending keys stay ascending in every writer.
+ * @param longest: out parameter for the seconds of the slowest insert.
+ * @return: the seconds it took, or a negative number if an insert failed.
+ */
+double addKeys(LockedTree *locked, ShardedRBTree *sharded, const long *keys, size_t items, int threads,
+               double *longest)
+{
+    void ** all = (void **) malloc(sizeof(void *) * items);
+    Writer * writers = (Writer *) calloc(threads, sizeof(Writer));
+    pthread_t * ids = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+    if(all == NULL || writers == NULL || ids == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    void ** next = all;
+    for(int t = 0; t < threads; ++t)
+    {
+        writers[t].locked = locked;
+        writers[t].sharded = sharded;
+        writers[t].items = next;
+        for(size_t i = t; i < items; i += threads)
+        {
+            next[writers[t].n++] = benchLong(keys[i]);
+        }
+        next += writers[t].n;
+    }
+    double start = benchSeconds();
+    for(int t = 0; t < threads; ++t)
+    {
+        if(pthread_create(&ids[t], NULL, writeItems, &writers[t]) != 0)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+    *longest = 0;
+    size_t failed = 0;
+    for(int t = 0; t < threads; ++t)
+    {
+        pthread_join(ids[t], NULL);
+        *longest = (writers[t].longest > *longest) ? writers[t].longest : *longest;
+        failed += writers[t].failed;
+    }
+    double seconds = benchSeconds() - start;
+    free(all);
+    free(writers);
+    free(ids);
+    return (failed == 0) ? seconds : -1;
+}
+
+/**
+ * forEachFunc that checks the items come in ascending order.
+ */
+int checkOrder(const void *object, void *args)
+{
+    const long ** previous = (const long **) args;
+    int ordered = (*previous == NULL || **previous < *(const long *) object);
+    *previous = (const long *) object;
+    return ordered;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t items = benchArg(argc, argv, 1, DEFAULT_ITEMS);
+    int most = (int) benchArg(argc, argv, 2, DEFAULT_THREADS);
+    int shards = (int) benchArg(argc, argv, 3, DEFAULT_SHARDS);
+    printf("%zu items, %d shards\n", items, shards);
+    printf("%-10s %7s %14s %14s %9s %13s %13s\n", "keys", "threads", "locked (Mops)", "sharded (Mops)", "speedup",
+           "locked (ms)", "sharded (ms)");
+    int failed = 0;
+    for(int scenario = RANDOM; scenario <= ASCENDING; ++scenario)
+    {
+        long * keys = makeKeys((Scenario) scenario, items);
+        for(int threads = 1; threads <= most; threads *= 2)
+        {
+            LockedTree locked;
+            locked.tree = newRBTree(benchCompareLong, benchFreeLong);
+            ShardedRBTree * sharded = newShardedRBTree(benchCompareLong, benchFreeLong, shards);
+            if(locked.tree == NULL || sharded == NULL || pthread_mutex_init(&locked.lock, NULL) != 0)
+            {
+                return EXIT_FAILURE;
+            }
+            double lockedLongest;
+            double shardedLongest;
+            double lockedSeconds = addKeys(&locked, NULL, keys, items, threads, &lockedLongest);
+            double shardedSeconds = addKeys(NULL, sharded, keys, items, threads, &shardedLongest);
+            printf("%-10s %7d %14.2f %14.2f %8.2fx %13.2f %13.2f\n", scenarioNames[scenario], threads,
+                   (double) items / lockedSeconds / 1e6, (double) items / shardedSeconds / 1e6,
+                   lockedSeconds / shardedSeconds, lockedLongest * 1e3, shardedLongest * 1e3);
+            const long * previous = NULL;
+            if(lockedSeconds < 0 || shardedSeconds < 0 || sizeShardedRBTree(sharded) != items ||
+               !forEachShardedRBTree(sharded, checkOrder, &previous))
+            {
+                printf("  wrong results: an insert failed, or the sharded tree lost or misordered items\n");
+                failed = 1;
+            }
+            freeRBTree(locked.tree);
+            pthread_mutex_destroy(&locked.lock);
+            freeShardedRBTree(sharded);
+        }
+        free(keys);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+/**
+ * compares knnVectorIndex and radiusVectorIndex against a brute-force forEachRBTree scan over the same tree
+ * of random Vectors, and checks that both find the same Vectors. the radius of each query is a multiple of
+ * the distance of its k-th neighbor, so every radius search finds a few times k Vectors.
+ * usage: vector_index_bench [vectors] [queries] [k]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "Bench.h"
+#include "RBTree.h"
+#include "Structs.h"
+#include "VectorIndex.h"
+
+#define DEFAULT_VECTORS 100000
+#define DEFAULT_QUERIES 200
+#define DEFAULT_K 10
+#define RADIUS_FACTOR 1.5 // the radius of a query is this many times the distance of its k-th neighbor
+#define SEED 88172645463325252UL
+#define UNIT (1.0 / 9007199254740992.0) // 2^-53, turns 53 random bits into [0, 1)
+
+static const size_t dimensions[] = {2, 4, 8, 16};
+
+/**
+ * the state of a brute-force search, the query and what it found so far.
+ */
+typedef struct Scan
+{
+    const Vector *query;
+    double radius; // squared, for a radius search
+    Vector **found; // the k nearest in ascending distance for a k-NN search, in tree order for a radius search
+    double *distances; // squared, of the k nearest
+    size_t count;
+    size_t k;
+} Scan;
+
+/**
+ * @return: a new Vector of dim coordinates in [0, 1), the benchmark exits if the allocation fails.
+ */
+Vector *randomVector(size_t dim, unsigned long *state)
+{
+    Vector * vector = (Vector *) malloc(sizeof(Vector));
+    double * coordinates = (double *) malloc(sizeof(double) * dim);
+    if(vector == NULL || coordinates == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < dim; ++i)
+    {
+        coordinates[i] = (double) (benchRandom(state) >> 11) * UNIT;
+    }
+    vector->len = dim;
+    vector->vector = coordinates;
+    return vector;
+}
+
+/**
+ * the squared L2 distance, summed in order.
+ */
+double bruteDistance(const Vector *a, const Vector *b)
+{
+    double sum = 0;
+    for(size_t i = 0; i < a->len; ++i)
+    {
+        double diff = a->vector[i] - b->vector[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+/**
+ * forEachFunc that keeps the k nearest Vectors seen so far, by insertion into a sorted array.
+ */
+int scanNearest(const void *object, void *args)
+{
+    Scan * scan = (Scan *) args;
+    double distance = bruteDistance((const Vector *) object, scan->query);
+    if(scan->count == scan->k && distance >= scan->distances[scan->k - 1])
+    {
+        return 1;
+    }
+    size_t i = (scan->count < scan->k) ? scan->count++ : scan->k - 1;
+    for(; i > 0 && scan->distances[i - 1] > distance; --i)
+    {
+        scan->found[i] = scan->found[i - 1];
+        scan->distances[i] = scan->distances[i - 1];
+    }
+    scan->found[i] = (Vector *) object;
+    scan->distances[i] = distance;
+    return 1;
+}
+
+/**
+ * forEachFunc that collects the Vectors within the radius of a brute-force search.
+ */
+int scanRadius(const void *object, void *args)
+{
+    Scan * scan = (Scan *) args;
+    if(bruteDistance((const Vector *) object, scan->query) <= scan->radius)
+    {
+        scan->found[scan->count++] = (Vector *) object;
+    }
+    return 1;
+}
+
+/**
+ * forEachFunc that collects the Vectors radiusVectorIndex reports.
+ */
+int collectFound(const void *object, void *args)
+{
+    Scan * scan = (Scan *) args;
+    scan->found[scan->count++] = (Vector *) object;
+    return 1;
+}
+
+/**
+ * qsort comparator for Vector pointers, by the Vectors.
+ */
+int compareVectorPointers(const void *a, const void *b)
+{
+    return vectorCompare1By1(*(Vector * const *) a, *(Vector * const *) b);
+}
+
+/**
+ * @return: 1 if the two arrays hold the same Vectors in any order, 0 otherwise. sorts both.
+ */
+int sameVectors(Vector **a, size_t countA, Vector **b, size_t countB)
+{
+    if(countA != countB)
+    {
+        return 0;
+    }
+    qsort(a, countA, sizeof(Vector *), compareVectorPointers);
+    qsort(b, countB, sizeof(Vector *), compareVectorPointers);
+    for(size_t i = 0; i < countA; ++i)
+    {
+        if(a[i] != b[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t vectors = benchArg(argc, argv, 1, DEFAULT_VECTORS);
+    size_t queries = benchArg(argc, argv, 2, DEFAULT_QUERIES);
+    size_t k = benchArg(argc, argv, 3, DEFAULT_K);
+    k = (k > vectors) ? vectors : k;
+    Vector ** expected = (Vector **) malloc(sizeof(Vector *) * vectors);
+    Vector ** actual = (Vector **) malloc(sizeof(Vector *) * vectors);
+    double * distances = (double *) malloc(sizeof(double) * k);
+    double * indexDistances = (double *) malloc(sizeof(double) * k);
+    if(expected == NULL || actual == NULL || distances == NULL || indexDistances == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("%zu random vectors, %zu queries, k = %zu, radius = %.1f * the k-th distance\n", vectors, queries, k,
+           RADIUS_FACTOR);
+    printf("%-4s %11s %11s %9s %11s %11s %9s %9s\n", "dim", "scan k-NN", "index k-NN", "speedup", "scan radius",
+           "index radius", "speedup", "found");
+    printf("%-4s %11s %11s %9s %11s %11s %9s %9s\n", "", "(us)", "(us)", "", "(us)", "(us)", "", "(avg)");
+    unsigned long state = SEED;
+    int failed = 0;
+    for(size_t d = 0; d < sizeof(dimensions) / sizeof(dimensions[0]); ++d)
+    {
+        size_t dim = dimensions[d];
+        RBTree * tree = newRBTree(vectorCompare1By1, freeVector);
+        if(tree == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        for(size_t i = 0; i < vectors; ++i)
+        {
+            if(!addToRBTree(tree, randomVector(dim, &state)))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        VectorIndex * index = newVectorIndex(tree);
+        if(index == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        double scanKnn = 0;
+        double indexKnn = 0;
+        double scanRadiusSeconds = 0;
+        double indexRadius = 0;
+        size_t radiusFound = 0;
+        size_t mismatches = 0;
+        for(size_t q = 0; q < queries; ++q)
+        {
+            Vector * query = randomVector(dim, &state);
+            Scan scan = {query, 0, expected, distances, 0, k};
+            double start = benchSeconds();
+            forEachRBTree(tree, scanNearest, &scan);
+            scanKnn += benchSeconds() - start;
+            start = benchSeconds();
+            int found = knnVectorIndex(index, query, (int) k, actual, indexDistances);
+            indexKnn += benchSeconds() - start;
+            double radius = (k > 0) ? RADIUS_FACTOR * indexDistances[k - 1] : 0;
+            mismatches += !sameVectors(expected, scan.count, actual, (found < 0) ? 0 : (size_t) found) ||
+                          (size_t) found != k;
+
+            Scan bruteRadius = {query, radius * radius, expected, NULL, 0, 0};
+            start = benchSeconds();
+            forEachRBTree(tree, scanRadius, &bruteRadius);
+            scanRadiusSeconds += benchSeconds() - start;
+            Scan indexScan = {query, 0, actual, NULL, 0, 0};
+            start = benchSeconds();
+            int completed = radiusVectorIndex(index, query, radius, collectFound, &indexScan);
+            indexRadius += benchSeconds() - start;
+            radiusFound += indexScan.count;
+            mismatches += !completed || !sameVectors(expected, bruteRadius.count, actual, indexScan.count);
+            freeVector(query);
+        }
+        double perQuery = 1e6 / (double) queries;
+        printf("%-4zu %11.1f %11.1f %8.1fx %11.1f %11.1f %8.1fx %9.1f\n", dim, scanKnn * perQuery,
+               indexKnn * perQuery, scanKnn / indexKnn, scanRadiusSeconds * perQuery, indexRadius * perQuery,
+               scanRadiusSeconds / indexRadius, (double) radiusFound / (double) queries);
+        if(mismatches != 0)
+        {
+            printf("  wrong results: %zu searches found other Vectors than the scan\n", mismatches);
+            failed = 1;
+        }
+        freeVectorIndex(index);
+        freeRBTree(tree);
+    }
+    free(expected);
+    free(actual);
+    free(distances);
+    free(indexDistances);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}